@@ -0,0 +1,683 @@
+#include "CompressorCore.h"
+
+#include <type_traits>
+
+// same as juce::Decibels::decibelsToGain (-100 dB floor)
+static float decibelsToGain (float dB) noexcept
+{
+    return dB > -100.0f ? std::pow (10.0f, dB * 0.05f) : 0.0f;
+}
+
+void CompressorCore::allocate (int channels, int maxBlockSize, int maxLookaheadSamples, bool doublePrecision)
+{
+    numChannels = std::min (maxChannels, std::max (1, channels));
+    blockCapacity = std::max (1, maxBlockSize);
+
+    detScratch.assign ((size_t) (numChannels * blockCapacity), 0.0f);
+    rampScratch.assign ((size_t) (4 * blockCapacity), 0.0f);
+
+    if (doublePrecision)
+        multibandScratch.assign ((size_t) ((numChannels + 2) * blockCapacity), 0.0f);
+    else
+        multibandScratch = {};
+
+    for (int ch = 0; ch < maxChannels; ++ch)
+    {
+        floatDelay[ch] = {};
+        doubleDelay[ch] = {};
+    }
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        lookaheadMax[ch].prepare (maxLookaheadSamples);
+        if (doublePrecision) doubleDelay[ch].prepare (maxLookaheadSamples);
+        else                 floatDelay[ch].prepare (maxLookaheadSamples);
+    }
+
+    multiband.allocate (numChannels, blockCapacity, maxLookaheadSamples);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        linkGroup[ch] = 0;
+    numLinkGroups = 1;
+}
+
+void CompressorCore::setSampleRate (double newSampleRate)
+{
+    sampleRate = newSampleRate;
+
+    detectors.prepare (sampleRate, numChannels); //followers + sidechain HPF for every channel
+    keyHpf.prepare (sampleRate);
+    multiband.setSampleRate (sampleRate);
+
+    inputGainRamp.reset (sampleRate, smoothingSeconds);
+    makeupGainRamp.reset (sampleRate, smoothingSeconds);
+    thresholdScaleRamp.reset (sampleRate, smoothingSeconds);
+    unlinkRamp.reset (sampleRate, smoothingSeconds);
+
+    coeffCache = {}; // prepare() reset the coefficients to defaults, so recompute everything on the next update
+    lookaheadSamples = 0; // the old count was at the old rate; setParameters sets it again
+}
+
+void CompressorCore::setLinkGroups (const int* groupOfChannel, int numGroups) noexcept
+{
+    for (int ch = 0; ch < numChannels; ++ch)
+        linkGroup[ch] = groupOfChannel[ch];
+    numLinkGroups = numGroups;
+}
+
+void CompressorCore::setParameters (const Parameters& p) noexcept
+{
+    auto& c = coeffCache;
+
+    if (! c.valid || p.attackMs != c.attackMs || p.releaseMs != c.releaseMs)
+    {
+        detectors.setTimeConstants (p.attackMs, p.releaseMs); //peak + RMS follower time constants
+        c.attackMs  = p.attackMs;
+        c.releaseMs = p.releaseMs;
+    }
+
+    // the HPF keeps its old cutoff while it's switched off, same as before
+    if (p.scHpfOn && (! c.valid || p.scHpfFreq != c.scHpfFreq))
+    {
+        detectors.setHpfCutoff (p.scHpfFreq);
+        c.scHpfFreq = p.scHpfFreq;
+    }
+
+    if (p.extHpfOn && (! c.valid || p.extHpfFreq != c.extHpfFreq))
+    {
+        keyHpf.setCutoff (p.extHpfFreq);
+        c.extHpfFreq = p.extHpfFreq;
+    }
+
+    // switching key source: the followers carry on, the key filter starts clean
+    if (p.externalKey != keyExternal)
+    {
+        keyHpf.reset();
+        keyExternal = p.externalKey;
+    }
+
+    if (! c.valid || p.thresholdDb != c.thresholdDb || p.ratio != c.ratio || p.kneeDb != c.kneeDb)
+    {
+        // the curve jumps to the new threshold; the detector scale takes the step and ramps back to 1
+        if (! c.valid)
+        {
+            thresholdScaleRamp.setCurrentAndTargetValue (1.0f);
+        }
+        else if (p.thresholdDb != c.thresholdDb)
+        {
+            thresholdScaleRamp.setCurrentAndTargetValue (thresholdScaleRamp.getCurrentValue()
+                                                         * decibelsToGain (p.thresholdDb - c.thresholdDb));
+            thresholdScaleRamp.setTargetValue (1.0f);
+        }
+
+        gainComputer.setParameters (p.thresholdDb, p.ratio, p.kneeDb);
+        c.thresholdDb = p.thresholdDb;
+        c.ratio       = p.ratio;
+        c.kneeDb      = p.kneeDb;
+    }
+
+    if (! c.valid || p.gainDb != c.gainDb)
+    {
+        inputGain = decibelsToGain (p.gainDb);
+        if (c.valid) inputGainRamp.setTargetValue (inputGain);
+        else         inputGainRamp.setCurrentAndTargetValue (inputGain);
+        c.gainDb = p.gainDb;
+    }
+
+    if (! c.valid || p.makeupDb != c.makeupDb)
+    {
+        makeupGain = decibelsToGain (p.makeupDb);
+        if (c.valid) makeupGainRamp.setTargetValue (makeupGain);
+        else         makeupGainRamp.setCurrentAndTargetValue (makeupGain);
+        c.makeupDb = p.makeupDb;
+    }
+
+    unlink = std::clamp (p.unlinkPct / 100.0f, 0.0f, 1.0f);
+    link   = 1.0f - unlink; // 1=linked, 0=unlinked
+    if (c.valid) unlinkRamp.setTargetValue (unlink); // no-op when it hasn't moved
+    else         unlinkRamp.setCurrentAndTargetValue (unlink);
+
+    if (p.mbMode > 0)
+    {
+        if (! multibandActive)
+            multiband.reset(); // it hasn't seen audio while it was off
+
+        multiband.setNumBands (p.mbMode == 2 ? 4 : 3);
+        multiband.setCrossovers (p.xover[0], p.xover[1], p.xover[2]);
+        for (int b = 0; b < MultibandCompressor::maxBands; ++b)
+            multiband.setBand (b, p.bands[b]); // recomputes only what changed
+        // the band detectors have one HPF, tuned to whichever key is active
+        if (keyExternal ? p.extHpfOn : p.scHpfOn)
+            multiband.setHpfCutoff (keyExternal ? p.extHpfFreq : p.scHpfFreq);
+    }
+    multibandActive = p.mbMode > 0;
+
+    bypass   = p.bypass;
+    rms      = p.detectorMode != 0;
+    scHpfOn  = p.scHpfOn;
+    keyHpfOn = p.extHpfOn;
+
+    const int newLookahead = (int) std::lround (p.lookaheadMs * 0.001 * sampleRate);
+    if (newLookahead != lookaheadSamples)
+        setLookaheadSamples (newLookahead);
+
+    c.valid = true;
+}
+
+void CompressorCore::setLookaheadSamples (int numSamples) noexcept
+{
+    if (lookaheadSamples == 0 && numSamples > 0)
+    {
+        // the rings weren't written while lookahead was off, so don't replay stale audio
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            lookaheadMax[ch].reset();
+            floatDelay[ch].reset();
+            doubleDelay[ch].reset();
+        }
+    }
+
+    lookaheadSamples = numSamples;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        lookaheadMax[ch].setWindow (numSamples);
+        floatDelay[ch].setDelay (numSamples);
+        doubleDelay[ch].setDelay (numSamples);
+    }
+    multiband.setLookahead (numSamples);
+}
+
+// Per-sample values for the next numSamples of every ramp that's still moving.
+// Settled parameters keep nullptr, so a static block costs four isSmoothing() checks.
+void CompressorCore::fillRamps (BlockSettings& s, int numSamples) noexcept
+{
+    s.inputGainRamp = s.makeupGainRamp = s.thresholdRamp = s.unlinkRamp = nullptr;
+
+    if (bypass) // nothing reads them, but a ramp in progress still ends on time
+    {
+        skip (numSamples);
+        return;
+    }
+
+    auto fill = [numSamples] (auto& ramp, float* dest)
+    {
+        for (int n = 0; n < numSamples; ++n)
+            dest[n] = ramp.getNextValue();
+        return dest;
+    };
+
+    float* scratch = rampScratch.data();
+
+    if (inputGainRamp.isSmoothing() || makeupGainRamp.isSmoothing())
+    {
+        s.inputGainRamp  = fill (inputGainRamp, scratch);
+        s.makeupGainRamp = fill (makeupGainRamp, scratch + blockCapacity);
+    }
+
+    if (thresholdScaleRamp.isSmoothing())
+        s.thresholdRamp = fill (thresholdScaleRamp, scratch + 2 * blockCapacity);
+
+    if (unlinkRamp.isSmoothing())
+        s.unlinkRamp = fill (unlinkRamp, scratch + 3 * blockCapacity);
+}
+
+void CompressorCore::skip (int numSamples) noexcept
+{
+    inputGainRamp.skip (numSamples);
+    makeupGainRamp.skip (numSamples);
+    thresholdScaleRamp.skip (numSamples);
+    unlinkRamp.skip (numSamples);
+}
+
+// Bypass doesn't run the detector side at all, and only the path that's active (broadband or multiband) is checked.
+bool CompressorCore::isSettled (float level) const noexcept
+{
+    if (bypass)
+        return true;
+
+    if (multibandActive)
+        return multiband.isSettled (level);
+
+    return detectors.isSettled (level) && (! keyExternal || keyHpf.isSettled (level));
+}
+
+template <typename Sample>
+LookaheadDelay<Sample>* CompressorCore::getLookaheadDelay() noexcept
+{
+    if constexpr (std::is_same_v<Sample, double>) return doubleDelay;
+    else                                          return floatDelay;
+}
+
+template <typename Sample>
+void CompressorCore::process (Sample* const* x, int numSamples, const Sample* const* key, int keyShift,
+                              const GainCurveTable* curve) noexcept
+{
+    std::fill (blockMinGain, blockMinGain + numChannels, 1.0f);
+    std::fill (blockMaxDetector, blockMaxDetector + numChannels, 0.0f);
+
+    BlockSettings s;
+    s.keyShift = keyShift;
+    if (curve != nullptr && curve->matches (coeffCache.thresholdDb, coeffCache.ratio, coeffCache.kneeDb))
+        s.curve = curve;
+    if (! keyExternal)
+        key = nullptr;
+
+    fillRamps (s, numSamples);
+
+    auto* lookaheadDelay = getLookaheadDelay<Sample>();
+
+    if (bypass)
+    {
+        if (lookaheadSamples > 0)
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int n = 0; n < numSamples; ++n)
+                    x[ch][n] = lookaheadDelay[ch].processSample (x[ch][n]);
+        return;
+    }
+
+    if (multibandActive)
+        return processMultiband (x, numSamples, key, s);
+
+    float* det[maxChannels] {};
+    for (int ch = 0; ch < numChannels; ++ch)
+        det[ch] = detScratch.data() + ch * blockCapacity;
+
+    // 1) detector: every channel advances one sample per step (DetectorBank keeps the state SoA)
+    runDetector (x, key, det, numSamples, s);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        float* d = det[ch];
+
+        // 1b) lookahead: the gain for each (delayed) sample comes from the loudest detector value in the window
+        if (lookaheadSamples > 0)
+            for (int n = 0; n < numSamples; ++n)
+                d[n] = lookaheadMax[ch].processSample (d[n]);
+
+        if (numSamples > 0)
+            blockMaxDetector[ch] = std::max (blockMaxDetector[ch], *std::max_element (d, d + numSamples));
+
+        // threshold still ramping: same as moving the threshold, relative to the curve's (target) one
+        if (s.thresholdRamp != nullptr)
+            for (int n = 0; n < numSamples; ++n)
+                d[n] *= s.thresholdRamp[n];
+
+        // 2) detector level -> linear gain for the whole block (table lookup or SIMD polynomial, in place)
+        if (referenceGainCurve)
+            gainComputer.processReference (d, d, numSamples);
+        else if (s.curve != nullptr)
+            s.curve->process (d, d, numSamples);
+        else if (specialisedLoops)
+            gainComputer.process (d, d, numSamples);
+        else
+            gainComputer.processGeneral (d, d, numSamples);
+
+        // 3) apply (to the delayed audio when lookahead is on)
+        applyGain (ch, x[ch], d, numSamples, s);
+    }
+}
+
+namespace
+{
+    template <typename Fn>
+    void dispatchBool (bool value, Fn&& fn)
+    {
+        if (value) fn (std::true_type {});
+        else       fn (std::false_type {});
+    }
+}
+
+// Picks the detector loop for this block's options
+template <typename Sample>
+void CompressorCore::runDetector (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples,
+                                  const BlockSettings& s) noexcept
+{
+    if (! specialisedLoops)
+        return detectorLoopGeneral (x, key, det, numSamples, s);
+
+    const LinkShape shape = s.unlinkRamp != nullptr ? LinkShape::ramped
+                          : unlink == 0.0f          ? LinkShape::linked
+                          : unlink == 1.0f          ? LinkShape::unlinked
+                                                    : LinkShape::blend;
+    const bool pair = isUsingStereoPairLoop();
+
+    dispatchBool (key != nullptr, [&] (auto external)
+    {
+        dispatchBool (external ? keyHpfOn : scHpfOn, [&] (auto hpf)
+        {
+            dispatchBool (rms, [&] (auto isRms)
+            {
+                constexpr bool e = decltype (external)::value, h = decltype (hpf)::value, r = decltype (isRms)::value;
+
+                if (pair)
+                {
+                    switch (shape)
+                    {
+                        case LinkShape::linked:   stereoDetectorLoop<Sample, e, h, r, LinkShape::linked>   (x, key, det, numSamples, s); break;
+                        case LinkShape::unlinked: stereoDetectorLoop<Sample, e, h, r, LinkShape::unlinked> (x, key, det, numSamples, s); break;
+                        case LinkShape::blend:    stereoDetectorLoop<Sample, e, h, r, LinkShape::blend>    (x, key, det, numSamples, s); break;
+                        case LinkShape::ramped:   stereoDetectorLoop<Sample, e, h, r, LinkShape::ramped>   (x, key, det, numSamples, s); break;
+                    }
+                    return;
+                }
+
+                switch (shape)
+                {
+                    case LinkShape::linked:   detectorLoop<Sample, e, h, r, LinkShape::linked>   (x, key, det, numSamples, s); break;
+                    case LinkShape::unlinked: detectorLoop<Sample, e, h, r, LinkShape::unlinked> (x, key, det, numSamples, s); break;
+                    case LinkShape::blend:    detectorLoop<Sample, e, h, r, LinkShape::blend>    (x, key, det, numSamples, s); break;
+                    case LinkShape::ramped:   detectorLoop<Sample, e, h, r, LinkShape::ramped>   (x, key, det, numSamples, s); break;
+                }
+            });
+        });
+    });
+}
+
+// Same numbers as detectorLoopGeneral: linked is frame * 0 + max * 1, unlinked frame * 1 + max * 0.
+template <typename Sample, bool externalKey, bool hpfOn, bool rms, CompressorCore::LinkShape linkShape>
+void CompressorCore::detectorLoop (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples,
+                                   const BlockSettings& s) noexcept
+{
+    alignas (32) float frame[maxChannels] {};
+    float groupMax[maxChannels + 2] {};
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        if constexpr (! externalKey)
+        {
+            const float gain = s.inputGainRamp != nullptr ? s.inputGainRamp[n] : inputGain;
+            for (int ch = 0; ch < numChannels; ++ch)
+                frame[ch] = (float) (x[ch][n] * gain);
+
+            detectors.processFrame<hpfOn, rms> (frame);
+        }
+        else
+        {
+            // external key, read in place (input gain doesn't drive it)
+            const int k = n >> s.keyShift;
+            for (int ch = 0; ch < numChannels; ++ch)
+                frame[ch] = (float) key[ch][k];
+
+            if constexpr (hpfOn)
+                keyHpf.processFrame (frame, numChannels);
+            detectors.processFrame<false, rms> (frame);
+        }
+
+        if constexpr (linkShape == LinkShape::unlinked)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                det[ch][n] = frame[ch];
+        }
+        else
+        {
+            // “max link” behavior, per link group (detector levels are >= 0, so 0 is a safe start)
+            std::fill (groupMax, groupMax + numLinkGroups, 0.0f);
+            for (int ch = 0; ch < numChannels; ++ch)
+                groupMax[linkGroup[ch]] = std::max (groupMax[linkGroup[ch]], frame[ch]);
+
+            if constexpr (linkShape == LinkShape::linked)
+            {
+                for (int ch = 0; ch < numChannels; ++ch)
+                    det[ch][n] = groupMax[linkGroup[ch]];
+            }
+            else
+            {
+                const float u = linkShape == LinkShape::ramped ? s.unlinkRamp[n] : unlink;
+                const float l = linkShape == LinkShape::ramped ? 1.0f - u : link;
+                for (int ch = 0; ch < numChannels; ++ch)
+                    det[ch][n] = frame[ch] * u + groupMax[linkGroup[ch]] * l;
+            }
+        }
+    }
+}
+
+// Stereo, one link group: L / R in lanes 0 / 1 of one register (2 and 3 idle), state loaded once and
+// stored back at the end. Per lane it's detectorLoop's arithmetic in the same order; the group max is
+// std::max (std::max (0, L), R) as there, then broadcast, so both channels see the same bits.
+template <typename Sample, bool externalKey, bool hpfOn, bool rms, CompressorCore::LinkShape linkShape>
+void CompressorCore::stereoDetectorLoop (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples,
+                                         const BlockSettings& s) noexcept
+{
+    float* hpfX1 = externalKey ? keyHpf.x1 : detectors.hpfX1;
+    float* hpfY1 = externalKey ? keyHpf.y1 : detectors.hpfY1;
+    float* follower = rms ? detectors.power : detectors.env;
+
+    const Lanes4 b0 = Lanes4::fill (externalKey ? keyHpf.b0 : detectors.b0);
+    const Lanes4 b1 = Lanes4::fill (externalKey ? keyHpf.b1 : detectors.b1);
+    const Lanes4 a1 = Lanes4::fill (externalKey ? keyHpf.a1 : detectors.a1);
+    const Lanes4 attack = Lanes4::fill (detectors.attackCoeff), release = Lanes4::fill (detectors.releaseCoeff);
+    const Lanes4 zero = Lanes4::fill (0.0f), u = Lanes4::fill (unlink), l = Lanes4::fill (link);
+
+    Lanes4 x1 = Lanes4::load (hpfX1), y1 = Lanes4::load (hpfY1), state = Lanes4::load (follower);
+    float* outL = det[0];
+    float* outR = det[1];
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        Lanes4 in;
+        if constexpr (! externalKey)
+        {
+            const float gain = s.inputGainRamp != nullptr ? s.inputGainRamp[n] : inputGain;
+            in = Lanes4::set ((float) (x[0][n] * gain), (float) (x[1][n] * gain));
+        }
+        else
+        {
+            const int k = n >> s.keyShift;
+            in = Lanes4::set ((float) key[0][k], (float) key[1][k]);
+        }
+
+        if constexpr (hpfOn)
+        {
+            const Lanes4 y0 = b0 * in + b1 * x1 - a1 * y1;
+            x1 = in;
+            y1 = y0;
+            in = y0;
+        }
+
+        Lanes4 level;
+        if constexpr (! rms)
+        {
+            const Lanes4 a = Lanes4::abs (in);
+            state = a + Lanes4::selectGreater (a, state, attack, release) * (state - a);
+            level = state;
+        }
+        else
+        {
+            const Lanes4 p = in * in;
+            state = p + Lanes4::selectGreater (p, state, attack, release) * (state - p);
+            level = Lanes4::sqrt (state);
+        }
+
+        Lanes4 out = level;
+        if constexpr (linkShape != LinkShape::unlinked)
+        {
+            const Lanes4 groupMax = Lanes4::broadcast0 (Lanes4::max (Lanes4::swapPairs (level), Lanes4::max (level, zero)));
+
+            if constexpr (linkShape == LinkShape::linked)
+                out = groupMax;
+            else if constexpr (linkShape == LinkShape::blend)
+                out = level * u + groupMax * l;
+            else
+                out = level * Lanes4::fill (s.unlinkRamp[n]) + groupMax * Lanes4::fill (1.0f - s.unlinkRamp[n]);
+        }
+
+        outL[n] = out.lane0();
+        outR[n] = out.lane1();
+    }
+
+    if constexpr (hpfOn)
+    {
+        x1.store (hpfX1);
+        y1.store (hpfY1);
+    }
+    state.store (follower);
+}
+
+// Every option checked per sample
+template <typename Sample>
+void CompressorCore::detectorLoopGeneral (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples,
+                                          const BlockSettings& s) noexcept
+{
+    alignas (32) float frame[maxChannels] {};
+    float groupMax[maxChannels + 2] {};
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        if (key == nullptr)
+        {
+            const float gain = s.inputGainRamp != nullptr ? s.inputGainRamp[n] : inputGain;
+            for (int ch = 0; ch < numChannels; ++ch)
+                frame[ch] = (float) (x[ch][n] * gain);
+
+            detectors.processFrame (frame, scHpfOn, rms);
+        }
+        else
+        {
+            const int k = n >> s.keyShift;
+            for (int ch = 0; ch < numChannels; ++ch)
+                frame[ch] = (float) key[ch][k];
+
+            if (keyHpfOn)
+                keyHpf.processFrame (frame, numChannels);
+            detectors.processFrame (frame, false, rms);
+        }
+
+        std::fill (groupMax, groupMax + numLinkGroups, 0.0f);
+        for (int ch = 0; ch < numChannels; ++ch)
+            groupMax[linkGroup[ch]] = std::max (groupMax[linkGroup[ch]], frame[ch]);
+
+        const float u = s.unlinkRamp != nullptr ? s.unlinkRamp[n] : unlink;
+        const float l = s.unlinkRamp != nullptr ? 1.0f - u : link;
+        for (int ch = 0; ch < numChannels; ++ch)
+            det[ch][n] = frame[ch] * u + groupMax[linkGroup[ch]] * l;
+    }
+}
+
+template <typename Sample>
+void CompressorCore::applyGain (int ch, Sample* out, const float* gain, int numSamples, const BlockSettings& s) noexcept
+{
+    if (! specialisedLoops)
+        return applyGainGeneral (ch, out, gain, numSamples, s);
+
+    dispatchBool (lookaheadSamples > 0, [&] (auto lookahead)
+    {
+        dispatchBool (s.inputGainRamp != nullptr, [&] (auto gainRamp)
+        {
+            applyGainLoop<Sample, decltype (lookahead)::value, decltype (gainRamp)::value> (ch, out, gain, numSamples, s);
+        });
+    });
+}
+
+// Without lookahead and ramps this is a plain multiply the compiler vectorises; the delay line keeps the
+// lookahead versions scalar.
+template <typename Sample, bool lookahead, bool gainRamp>
+void CompressorCore::applyGainLoop (int ch, Sample* out, const float* gain, int numSamples, const BlockSettings& s) noexcept
+{
+    float minGain = blockMinGain[ch];
+    for (int n = 0; n < numSamples; ++n)
+        minGain = std::min (minGain, gain[n]);
+    blockMinGain[ch] = minGain;
+
+    auto& delay = getLookaheadDelay<Sample>()[ch];
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        Sample in = out[n];
+        if constexpr (lookahead)
+            in = delay.processSample (in);
+
+        if constexpr (gainRamp)
+            out[n] = in * s.inputGainRamp[n] * gain[n] * s.makeupGainRamp[n];
+        else
+            out[n] = in * inputGain * gain[n] * makeupGain;
+    }
+}
+
+template <typename Sample>
+void CompressorCore::applyGainGeneral (int ch, Sample* out, const float* gain, int numSamples, const BlockSettings& s) noexcept
+{
+    auto* lookaheadDelay = getLookaheadDelay<Sample>();
+    float minGain = blockMinGain[ch];
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        minGain = std::min (minGain, gain[n]);
+
+        Sample in = out[n];
+        if (lookaheadSamples > 0)
+            in = lookaheadDelay[ch].processSample (in);
+
+        if (s.inputGainRamp == nullptr)
+            out[n] = in * inputGain * gain[n] * makeupGain;
+        else
+            out[n] = in * s.inputGainRamp[n] * gain[n] * s.makeupGainRamp[n];
+    }
+
+    blockMinGain[ch] = minGain;
+}
+
+template <typename Sample>
+void CompressorCore::processMultiband (Sample* const* x, int numSamples, const Sample* const* key, const BlockSettings& s) noexcept
+{
+    MultibandCompressor::Settings ms;
+    ms.hpfOn = scHpfOn;
+    ms.rms = rms;
+    ms.unlink = unlink;
+    ms.link = link;
+    ms.inputGain = inputGain;
+    ms.makeupGain = makeupGain;
+    ms.inputGainRamp = s.inputGainRamp;
+    ms.makeupGainRamp = s.makeupGainRamp;
+    ms.unlinkRamp = s.unlinkRamp; // the broadband threshold doesn't apply to the bands
+    ms.linkGroup = linkGroup;
+    ms.numLinkGroups = numLinkGroups;
+    if (key != nullptr)
+    {
+        ms.hpfOn = keyHpfOn;
+        ms.keyShift = s.keyShift;
+    }
+
+    if constexpr (std::is_same_v<Sample, float>)
+    {
+        ms.key = key;
+        multiband.process (x, numSamples, ms, blockMinGain, blockMaxDetector);
+    }
+    else
+    {
+        // the band filters are float: convert the block (and key) in and the result back out
+        float* audio[maxChannels] {};
+        const float* keyFloat[maxChannels] {};
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            audio[ch] = multibandScratch.data() + ch * blockCapacity;
+            for (int n = 0; n < numSamples; ++n)
+                audio[ch][n] = (float) x[ch][n];
+        }
+
+        if (key != nullptr)
+        {
+            const int keySamples = ((numSamples - 1) >> s.keyShift) + 1;
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const int slot = ch > 0 && key[ch] != key[0] ? 1 : 0; // at most two distinct key channels
+                float* k = multibandScratch.data() + (numChannels + slot) * blockCapacity;
+                if (ch <= 1)
+                    for (int n = 0; n < keySamples; ++n)
+                        k[n] = (float) key[ch][n];
+                keyFloat[ch] = k;
+            }
+            ms.key = keyFloat;
+        }
+
+        multiband.process (audio, numSamples, ms, blockMinGain, blockMaxDetector);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int n = 0; n < numSamples; ++n)
+                x[ch][n] = (double) audio[ch][n];
+    }
+}
+
+template void CompressorCore::process<float> (float* const*, int, const float* const*, int, const GainCurveTable*) noexcept;
+template void CompressorCore::process<double> (double* const*, int, const double* const*, int, const GainCurveTable*) noexcept;
@@ -0,0 +1,222 @@
+#pragma once
+#include <cmath>
+#include <vector>
+
+#include "Followers.h"
+#include "GainComputer.h"
+#include "Lanes.h"
+#include "Lookahead.h"
+#include "Multiband.h"
+#include "Smoothing.h"
+
+// The compressor itself, without the plugin around it.
+//
+// Detector (sidechain HPF + peak / RMS followers), channel linking, lookahead, gain curve, gain and
+// the multiband path, run a block at a time on raw channel pointers at whatever rate it's given.
+// The plugin adds parameters, oversampling, the sidechain bus and metering on top; the command line
+// tools, or anything else linking the StereoCompressorDsp library, can drive it directly:
+//
+//     CompressorCore core;
+//     core.allocate (2, 512, CompressorCore::maxLookaheadSamplesFor (48000.0));
+//     core.setSampleRate (48000.0);
+//     core.setParameters (params);                 // once per block, only what changed is recomputed
+//     core.process (channels, numSamples);         // in place, numSamples <= the allocated block size
+//
+// allocate() and setSampleRate() allocate / clear state; everything else is safe on the audio thread.
+class CompressorCore
+{
+public:
+    static constexpr int maxChannels = DetectorBank::maxChannels;
+    static constexpr float maxLookaheadMs = 10.0f;
+
+    // Plain values, as the plugin's parameters hold them
+    struct Parameters
+    {
+        bool bypass = false;       // the lookahead delay still runs, so the latency doesn't jump
+        float gainDb = 0.0f;       // input gain, ahead of the detector
+        int detectorMode = 0;      // 0 = peak, 1 = RMS
+        bool scHpfOn = false;
+        float scHpfFreq = 80.0f;
+        float unlinkPct = 0.0f;    // 0 = every link group shares its loudest channel, 100 = per channel
+        float thresholdDb = -18.0f;
+        float kneeDb = 6.0f;
+        float makeupDb = 0.0f;
+        float ratio = 4.0f;
+        float attackMs = 10.0f;
+        float releaseMs = 100.0f;
+        float lookaheadMs = 0.0f;
+        bool externalKey = false;  // the detector listens to the key passed to process()
+        bool extHpfOn = false;
+        float extHpfFreq = 80.0f;
+        int mbMode = 0;            // 0 = off, 1 = 3 bands, 2 = 4 bands
+        float xover[3] = { 120.0f, 1000.0f, 5000.0f };
+        MultibandCompressor::Band bands[MultibandCompressor::maxBands];
+    };
+
+    static int maxLookaheadSamplesFor (double maxSampleRate) noexcept
+    {
+        return (int) std::ceil (maxLookaheadMs * 0.001 * maxSampleRate);
+    }
+
+    // Allocation happens here only. maxBlockSize and maxLookaheadSamples are at the highest rate
+    // setSampleRate() will be given; the delay lines hold audio, so they're built for one precision.
+    void allocate (int numChannels, int maxBlockSize, int maxLookaheadSamples, bool doublePrecision = false);
+
+    // Rate change: recomputes everything on the next setParameters() and clears the state.
+    // The ramp time set before it is what the ramps use from here on.
+    void setSampleRate (double sampleRate);
+    void setSmoothingTime (double seconds) noexcept { smoothingSeconds = seconds; }
+
+    // groupOfChannel[ch] in 0..numGroups-1; channels in the same group share the group's max detector
+    // level (blended in by unlink). Default: one group.
+    void setLinkGroups (const int* groupOfChannel, int numGroups) noexcept;
+
+    // Change-driven: std::exp / pow only run when their inputs moved. Gain, makeup, threshold and
+    // unlink ramp to new values over the smoothing time instead of stepping.
+    void setParameters (const Parameters&) noexcept;
+
+    // In place. key: per-channel external key pointers, read at sample n >> keyShift (so a key at
+    // 1 / 2^keyShift of the processing rate is held across the oversampled samples); nullptr = the
+    // detector listens to the input. curve: a table for the current threshold / ratio / knee, used
+    // instead of the GainComputer when it matches them (anything else, or nullptr, is ignored).
+    template <typename Sample>
+    void process (Sample* const* channels, int numSamples,
+                  const Sample* const* key = nullptr, int keyShift = 0,
+                  const GainCurveTable* curve = nullptr) noexcept;
+
+    // Instead of process() for a block that's skipped: the ramps still move on
+    void skip (int numSamples) noexcept;
+
+    // Whether running the detector side on more silence would change anything (followers, HPFs and
+    // crossovers of the active path all below level). The lookahead delay isn't checked.
+    bool isSettled (float level) const noexcept;
+
+    // The broadband loops come as template instantiations over (peak / RMS x HPF on / off x internal /
+    // external key x linked / unlinked / blended / ramping link) and (lookahead x gain ramp), picked once per
+    // block, plus a hard-knee gain computer kernel. Off runs the general loops that check every option per
+    // sample instead; the output is the same either way, so this is only for benchmarking.
+    void setSpecialisedLoops (bool shouldSpecialise) noexcept { specialisedLoops = shouldSpecialise; }
+
+    // Stereo (two channels, one link group): the specialised detector loop keeps the L / R filter and
+    // follower state in one SIMD register for the whole block instead of a pass over the bank per sample.
+    // Same output; off falls back to the bank's per-frame loop, again only for benchmarking.
+    void setStereoPairLoop (bool shouldUsePair) noexcept { stereoPairLoop = shouldUsePair; }
+
+    // Whether the broadband detector currently runs the stereo pair loop (on, specialised, two channels, one link group)
+    bool isUsingStereoPairLoop() const noexcept
+    {
+        return stereoPairLoop && specialisedLoops && numChannels == 2 && numLinkGroups == 1;
+    }
+
+    // The broadband gain curve through GainComputer::processReference (scalar log10 / pow) instead of the
+    // SIMD approximation or the table. Slower and not what the plugin runs: it's the reference the
+    // regression tool checks the fast paths against. The multiband path isn't affected.
+    void setReferenceGainCurve (bool shouldUseReference) noexcept { referenceGainCurve = shouldUseReference; }
+
+    int getLookaheadSamples() const noexcept { return lookaheadSamples; }
+    int getNumChannels() const noexcept { return numChannels; }
+
+    // From the last process() call, per channel: lowest gain applied and loudest detector level
+    const float* getMinGain() const noexcept { return blockMinGain; }
+    const float* getMaxDetector() const noexcept { return blockMaxDetector; }
+
+private:
+    struct BlockSettings
+    {
+        const GainCurveTable* curve = nullptr; // nullptr = table not rebuilt yet, use gainComputer
+        int keyShift = 0;
+
+        // per-sample values while a ramp is active, nullptr once it has settled
+        const float* inputGainRamp = nullptr;  // set together with makeupGainRamp
+        const float* makeupGainRamp = nullptr;
+        const float* thresholdRamp = nullptr;  // detector scale
+        const float* unlinkRamp = nullptr;
+    };
+
+    // How the detector levels of a link group combine: all the group's max (unlink 0), each channel's
+    // own (unlink 1), a fixed blend, or a blend that's ramping
+    enum class LinkShape { linked, unlinked, blend, ramped };
+
+    void fillRamps (BlockSettings&, int numSamples) noexcept;
+    void setLookaheadSamples (int numSamples) noexcept;
+
+    template <typename Sample> LookaheadDelay<Sample>* getLookaheadDelay() noexcept;
+    template <typename Sample> void processMultiband (Sample* const* x, int numSamples, const Sample* const* key, const BlockSettings&) noexcept;
+
+    template <typename Sample> void runDetector (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples, const BlockSettings&) noexcept;
+    template <typename Sample, bool externalKey, bool hpfOn, bool rms, LinkShape linkShape>
+    void detectorLoop (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples, const BlockSettings&) noexcept;
+    template <typename Sample, bool externalKey, bool hpfOn, bool rms, LinkShape linkShape>
+    void stereoDetectorLoop (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples, const BlockSettings&) noexcept;
+    template <typename Sample> void detectorLoopGeneral (const Sample* const* x, const Sample* const* key, float* const* det, int numSamples, const BlockSettings&) noexcept;
+
+    template <typename Sample> void applyGain (int ch, Sample* out, const float* gain, int numSamples, const BlockSettings&) noexcept;
+    template <typename Sample, bool lookahead, bool gainRamp>
+    void applyGainLoop (int ch, Sample* out, const float* gain, int numSamples, const BlockSettings&) noexcept;
+    template <typename Sample> void applyGainGeneral (int ch, Sample* out, const float* gain, int numSamples, const BlockSettings&) noexcept;
+
+    int numChannels = 2;
+    int blockCapacity = 0;
+    bool specialisedLoops = true;
+    bool stereoPairLoop = true;
+    bool referenceGainCurve = false;
+    double sampleRate = 44100.0;
+
+    // Sidechain (detector) HPF + peak / RMS followers for every channel, structure-of-arrays
+    DetectorBank detectors;
+    HighPassBank keyHpf; // the external key's own HPF
+
+    int linkGroup[maxChannels] {};
+    int numLinkGroups = 1;
+
+    // Static curve, used for the blocks between a parameter change and a matching table
+    GainComputer gainComputer;
+
+    SlidingWindowMax lookaheadMax[maxChannels];
+    LookaheadDelay<float> floatDelay[maxChannels];
+    LookaheadDelay<double> doubleDelay[maxChannels]; // only built for double precision
+    int lookaheadSamples = 0;
+
+    MultibandCompressor multiband;
+
+    // Current values, as setParameters() last resolved them
+    bool bypass = false;
+    bool rms = false;
+    bool scHpfOn = false;
+    bool keyHpfOn = false;
+    bool keyExternal = false;
+    bool multibandActive = false;
+    float unlink = 0.0f, link = 1.0f;
+    float inputGain = 1.0f, makeupGain = 1.0f;
+
+    // Values the current coefficients were computed from (valid = false forces a full update)
+    struct CoefficientCache
+    {
+        bool valid = false;
+        float attackMs = 0.0f, releaseMs = 0.0f;
+        float scHpfFreq = 0.0f; // 0 = never set (the plugin's parameter starts at 20 Hz)
+        float extHpfFreq = 0.0f;
+        float thresholdDb = 0.0f, ratio = 0.0f, kneeDb = 0.0f;
+        float gainDb = 0.0f, makeupDb = 0.0f;
+    };
+
+    CoefficientCache coeffCache;
+
+    // ---- Smoothing: the ramps run at the processing rate and only produce per-sample values while
+    // they're moving; once settled the block sees nullptr and takes the constant path. Threshold ramps
+    // as a scale on the detector (1 = at the target), so the gain curve / table only ever describes
+    // the target threshold. ----
+    double smoothingSeconds = 0.02;
+
+    MultiplicativeRamp inputGainRamp { 1.0f };
+    MultiplicativeRamp makeupGainRamp { 1.0f };
+    MultiplicativeRamp thresholdScaleRamp { 1.0f };
+    LinearRamp unlinkRamp { 0.0f };
+
+    // Scratch, one block at the highest rate: detector level in / linear gain out per channel,
+    // the four ramps, and the multiband path's float copy of a double block (+ up to 2 key channels)
+    std::vector<float> detScratch, rampScratch, multibandScratch;
+
+    float blockMinGain[maxChannels] {};
+    float blockMaxDetector[maxChannels] {};
+};
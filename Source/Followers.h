@@ -0,0 +1,318 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+// Detector building blocks, just floats.
+//
+// OnePoleHPF / EnvelopeFollower / RMSFollower are the single-channel versions (the reference math),
+// templated on the sample type; the <float> instantiations are what the detector has always run.
+// DetectorBank runs the same recurrences for every channel of a bus at once, with the state
+// stored structure-of-arrays so one step of the loop over channels maps onto SIMD lanes.
+
+template <typename Sample = float>
+struct OnePoleHPF
+{
+    void prepare (double sampleRate)
+    {
+        sr = sampleRate;
+        reset();
+        setCutoff (Sample (80)); //default cutoff frequency
+    }
+    void reset()
+    {
+        x1 = Sample (0);
+        y1 = Sample (0);
+    }
+    void setCutoff (Sample hz)
+    {
+        hz = std::min (Sample (20000), std::max (Sample (1), hz));
+        const Sample w = Sample (2) * Sample (3.14159265358979323846) * hz / (Sample) sr;
+        const Sample x = std::exp (-w);
+
+        a1 = x;
+        b0 = (Sample (1) + x) * Sample (0.5);
+        b1 = -b0;
+    }
+    Sample processSample (Sample x0)
+    {
+        const Sample y0 = b0 * x0 + b1 * x1 - a1 * y1;
+        x1 = x0;
+        y1 = y0;
+        return y0;
+    }
+    double sr = 44100.0;
+    Sample a1 = 0, b0 = 0, b1 = 0;
+    Sample x1 = 0, y1 = 0;
+};
+
+template <typename Sample = float>
+struct EnvelopeFollower
+{
+    void prepare (double sampleRate)
+    {
+        sr = sampleRate;
+        env = Sample (0);
+        updateTimeConstants (Sample (10), Sample (100));
+    }
+
+    void updateTimeConstants (Sample attackMs, Sample releaseMs)
+    {
+        attackCoeff  = std::exp (Sample (-1) / (Sample (0.001) * attackMs  * (Sample) sr));
+        releaseCoeff = std::exp (Sample (-1) / (Sample (0.001) * releaseMs * (Sample) sr));
+    }
+
+    Sample processSample (Sample x)
+    {
+        x = std::fabs (x); //floating absolute value
+        const Sample coeff = (x > env) ? attackCoeff : releaseCoeff;
+        env = x + coeff * (env - x);
+        return env;
+    }
+
+    Sample getEnvelope() const { return env; }
+
+    double sr = 44100.0;
+    Sample env = 0;
+    Sample attackCoeff = 0;
+    Sample releaseCoeff = 0;
+};
+
+template <typename Sample = float>
+struct RMSFollower
+{
+    void prepare (double sampleRate)
+    {
+        sr = sampleRate;
+        envPower = Sample (0);
+        updateTimeConstants (Sample (10), Sample (100));
+    }
+
+    void updateTimeConstants (Sample attackMs, Sample releaseMs)
+    {
+        attackCoeff  = std::exp (Sample (-1) / (Sample (0.001) * attackMs  * (Sample) sr));
+        releaseCoeff = std::exp (Sample (-1) / (Sample (0.001) * releaseMs * (Sample) sr));
+    }
+
+    Sample processSample (Sample x)
+    {
+        const Sample p = x * x; // power
+        const Sample coeff = (p > envPower) ? attackCoeff : releaseCoeff;
+        envPower = p + coeff * (envPower - p);
+        return std::sqrt (envPower);
+    }
+
+    double sr = 44100.0;
+    Sample envPower = 0;
+    Sample attackCoeff = 0;
+    Sample releaseCoeff = 0;
+};
+
+// OnePoleHPF for up to maxChannels channels, structure-of-arrays (the external key filter).
+struct HighPassBank
+{
+    static constexpr int maxChannels = 16;
+
+    void prepare (double sampleRate)
+    {
+        sr = sampleRate;
+        reset();
+        setCutoff (80.0f);
+    }
+
+    void reset()
+    {
+        std::fill (std::begin (x1), std::end (x1), 0.0f);
+        std::fill (std::begin (y1), std::end (y1), 0.0f);
+    }
+
+    void setCutoff (float hz)
+    {
+        OnePoleHPF<float> h;
+        h.sr = sr;
+        h.setCutoff (hz);
+        a1 = h.a1;
+        b0 = h.b0;
+        b1 = h.b1;
+    }
+
+    // True once every channel's filter state is below level (the processor's idle check).
+    bool isSettled (float level) const noexcept
+    {
+        for (int c = 0; c < maxChannels; ++c)
+            if (std::fabs (x1[c]) >= level || std::fabs (y1[c]) >= level)
+                return false;
+        return true;
+    }
+
+    // One sample frame in place, numChannels values.
+    void processFrame (float* x, int numChannels)
+    {
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const float y0 = b0 * x[c] + b1 * x1[c] - a1 * y1[c];
+            x1[c] = x[c];
+            y1[c] = y0;
+            x[c] = y0;
+        }
+    }
+
+    double sr = 44100.0;
+    float a1 = 0.0f, b0 = 0.0f, b1 = 0.0f;
+    alignas (32) float x1[maxChannels] {};
+    alignas (32) float y1[maxChannels] {};
+};
+
+// Sidechain HPF + peak / RMS follower for up to maxChannels channels.
+// Per channel it is exactly OnePoleHPF -> EnvelopeFollower or RMSFollower (same coefficients,
+// same operation order), so a stereo bank produces the same numbers as two scalar chains.
+struct DetectorBank
+{
+    static constexpr int maxChannels = 16; // 7.1.4 is 12
+
+    void prepare (double sampleRate, int channels)
+    {
+        sr = sampleRate;
+        numChannels = std::min (maxChannels, std::max (1, channels));
+        paddedChannels = (numChannels + 3) & ~3; // whole SIMD registers; the extra lanes just carry zeros
+        reset();
+        setTimeConstants (10.0f, 100.0f);
+        setHpfCutoff (80.0f);
+    }
+
+    void reset()
+    {
+        std::fill (std::begin (env), std::end (env), 0.0f);
+        std::fill (std::begin (power), std::end (power), 0.0f);
+        std::fill (std::begin (hpfX1), std::end (hpfX1), 0.0f);
+        std::fill (std::begin (hpfY1), std::end (hpfY1), 0.0f);
+    }
+
+    void setTimeConstants (float attackMs, float releaseMs)
+    {
+        EnvelopeFollower<float> f; // same formula as the scalar followers, by construction
+        f.sr = sr;
+        f.updateTimeConstants (attackMs, releaseMs);
+        attackCoeff = f.attackCoeff;
+        releaseCoeff = f.releaseCoeff;
+    }
+
+    void setHpfCutoff (float hz)
+    {
+        OnePoleHPF<float> h;
+        h.sr = sr;
+        h.setCutoff (hz);
+        a1 = h.a1;
+        b0 = h.b0;
+        b1 = h.b1;
+    }
+
+    // True once the followers and the HPF have decayed below level on every channel: running the bank
+    // on silence from here on wouldn't move the gain, so the processor may stop calling it.
+    bool isSettled (float level) const noexcept
+    {
+        for (int c = 0; c < numChannels; ++c)
+            if (env[c] >= level || power[c] >= level * level
+                || std::fabs (hpfX1[c]) >= level || std::fabs (hpfY1[c]) >= level)
+                return false;
+        return true;
+    }
+
+    // One sample frame in place: x[c] = detector input for channel c -> detector level.
+    // x must hold paddedChannels values (zeros past numChannels).
+    // The options are template arguments so the caller picks a version once per block; each step is a
+    // fixed 4-lane group (paddedChannels is a multiple of 4), which the compiler turns into one SIMD op.
+    // Per lane it's the same arithmetic as the runtime version below.
+    template <bool hpfOn, bool rms>
+    void processFrame (float* x) noexcept
+    {
+        for (int g = 0; g < paddedChannels; g += 4)
+        {
+            float* xg = x + g;
+
+            if constexpr (hpfOn)
+            {
+                float* hx = hpfX1 + g;
+                float* hy = hpfY1 + g;
+                for (int l = 0; l < 4; ++l)
+                {
+                    const float y0 = b0 * xg[l] + b1 * hx[l] - a1 * hy[l];
+                    hx[l] = xg[l];
+                    hy[l] = y0;
+                    xg[l] = y0;
+                }
+            }
+
+            if constexpr (! rms)
+            {
+                float* e = env + g;
+                for (int l = 0; l < 4; ++l)
+                {
+                    const float a = std::fabs (xg[l]);
+                    const float coeff = (a > e[l]) ? attackCoeff : releaseCoeff;
+                    e[l] = a + coeff * (e[l] - a);
+                    xg[l] = e[l];
+                }
+            }
+            else
+            {
+                float* pw = power + g;
+                for (int l = 0; l < 4; ++l)
+                {
+                    const float p = xg[l] * xg[l];
+                    const float coeff = (p > pw[l]) ? attackCoeff : releaseCoeff;
+                    pw[l] = p + coeff * (pw[l] - p);
+                    xg[l] = std::sqrt (pw[l]);
+                }
+            }
+        }
+    }
+
+    // Options checked every frame (the reference for the version above)
+    void processFrame (float* x, bool hpfOn, bool rms)
+    {
+        if (hpfOn)
+        {
+            for (int c = 0; c < paddedChannels; ++c)
+            {
+                const float y0 = b0 * x[c] + b1 * hpfX1[c] - a1 * hpfY1[c];
+                hpfX1[c] = x[c];
+                hpfY1[c] = y0;
+                x[c] = y0;
+            }
+        }
+
+        if (! rms)
+        {
+            for (int c = 0; c < paddedChannels; ++c)
+            {
+                const float a = std::fabs (x[c]);
+                const float coeff = (a > env[c]) ? attackCoeff : releaseCoeff;
+                env[c] = a + coeff * (env[c] - a);
+                x[c] = env[c];
+            }
+        }
+        else
+        {
+            for (int c = 0; c < paddedChannels; ++c)
+            {
+                const float p = x[c] * x[c];
+                const float coeff = (p > power[c]) ? attackCoeff : releaseCoeff;
+                power[c] = p + coeff * (power[c] - p);
+                x[c] = std::sqrt (power[c]);
+            }
+        }
+    }
+
+    double sr = 44100.0;
+    int numChannels = 2;
+    int paddedChannels = 4;
+
+    float attackCoeff = 0.0f, releaseCoeff = 0.0f;
+    float a1 = 0.0f, b0 = 0.0f, b1 = 0.0f;
+
+    alignas (32) float env[maxChannels] {};   // peak follower
+    alignas (32) float power[maxChannels] {}; // RMS follower (mean square)
+    alignas (32) float hpfX1[maxChannels] {};
+    alignas (32) float hpfY1[maxChannels] {};
+};
@@ -0,0 +1,509 @@
+#include "GainComputer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define GAINCOMPUTER_X86 1
+ #include <immintrin.h>
+ #if defined(_MSC_VER) && ! defined(__clang__)
+  #include <intrin.h>
+  #define GAINCOMPUTER_TARGET_AVX2
+ #else
+  #define GAINCOMPUTER_TARGET_AVX2 __attribute__ ((target ("avx2")))
+ #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #define GAINCOMPUTER_NEON 1
+ #include <arm_neon.h>
+#endif
+
+namespace
+{
+    // 20 * log10 (2) and its inverse: dB <-> log2 units
+    constexpr float dbPerLog2 = 6.0205999132796239f;
+    constexpr float log2PerDb = 0.16609640474436813f;
+
+    // log2 (1 + t), t in [0, 1): least-squares fit, |err| < 1.7e-5
+    constexpr float l1 =  1.4418799f;
+    constexpr float l2 = -0.708865218f;
+    constexpr float l3 =  0.415245562f;
+    constexpr float l4 = -0.193516526f;
+    constexpr float l5 =  0.0452682933f;
+
+    // 2^f, f in [0, 1): relative err < 8e-8
+    constexpr float e0 = 0.999999927f;
+    constexpr float e1 = 0.693152968f;
+    constexpr float e2 = 0.24015453f;
+    constexpr float e3 = 0.0558236056f;
+    constexpr float e4 = 0.00899258276f;
+    constexpr float e5 = 0.00187623346f;
+
+    // gain reduction goes down to roughly -120 dB (about -20 in log2), so this clamp never bites in practice
+    constexpr float minLog2Gain = -126.0f;
+
+    inline float bitsToFloat (uint32_t b) { float f; std::memcpy (&f, &b, sizeof (f)); return f; }
+    inline uint32_t floatToBits (float f) { uint32_t b; std::memcpy (&b, &f, sizeof (b)); return b; }
+
+    inline float fastLog2 (float x)
+    {
+        const uint32_t bits = floatToBits (x);
+        const float e = (float) ((int) ((bits >> 23) & 0xff) - 127);
+        const float t = bitsToFloat ((bits & 0x007fffffu) | 0x3f800000u) - 1.0f;
+        return e + t * (l1 + t * (l2 + t * (l3 + t * (l4 + t * l5))));
+    }
+
+    inline float fastExp2 (float x)
+    {
+        x = std::max (minLog2Gain, std::min (0.0f, x));
+        const float fi = std::floor (x);
+        const float f = x - fi;
+        const float p = e0 + f * (e1 + f * (e2 + f * (e3 + f * (e4 + f * e5))));
+        return p * bitsToFloat ((uint32_t) ((int) fi + 127) << 23);
+    }
+
+    // one sample of the branchless curve:
+    //   grDb = slope * (max (d - K/2, 0) + clamp (d + K/2, 0, K)^2 / 2K),  d = xDb - T
+    // which is the hard-knee line above the knee, the quadratic inside it and 0 below it.
+    // Every kernel comes in two versions, picked once per block: with K = 0 the knee term is exactly 0
+    // (clamp (d, 0, 0) * 0), so the hard-knee version drops it and gives the same bits for less work.
+    template <bool softKnee>
+    inline float fastGain (const GainComputer& gc, float det)
+    {
+        const float d = fastLog2 (det + GainComputer::detectorEps) * dbPerLog2 - gc.thresholdDb;
+        float grDb;
+        if constexpr (softKnee)
+        {
+            const float over = std::max (d - gc.halfKnee, 0.0f);
+            const float c = std::min (std::max (d + gc.halfKnee, 0.0f), gc.kneeDb);
+            grDb = gc.slope * (over + c * c * gc.invTwoKnee);
+        }
+        else
+        {
+            grDb = gc.slope * std::max (d, 0.0f);
+        }
+        return fastExp2 (grDb * log2PerDb);
+    }
+
+    template <bool softKnee>
+    void processScalar (const GainComputer& gc, const float* det, float* gain, int numSamples)
+    {
+        for (int n = 0; n < numSamples; ++n)
+            gain[n] = fastGain<softKnee> (gc, det[n]);
+    }
+
+   #if GAINCOMPUTER_X86
+    template <bool softKnee>
+    void processSSE2 (const GainComputer& gc, const float* det, float* gain, int numSamples)
+    {
+        const __m128 eps      = _mm_set1_ps (GainComputer::detectorEps);
+        const __m128 one      = _mm_set1_ps (1.0f);
+        const __m128 zero     = _mm_setzero_ps();
+        const __m128i mantMask = _mm_set1_epi32 (0x007fffff);
+        const __m128i oneBits  = _mm_set1_epi32 (0x3f800000);
+        const __m128i bias     = _mm_set1_epi32 (127);
+        const __m128 thresh   = _mm_set1_ps (gc.thresholdDb);
+        const __m128 halfK    = _mm_set1_ps (gc.halfKnee);
+        const __m128 knee     = _mm_set1_ps (gc.kneeDb);
+        const __m128 slope    = _mm_set1_ps (gc.slope);
+        const __m128 invTwoK  = _mm_set1_ps (gc.invTwoKnee);
+        const __m128 minL2    = _mm_set1_ps (minLog2Gain);
+
+        int n = 0;
+        for (; n + 4 <= numSamples; n += 4)
+        {
+            // log2
+            const __m128 x = _mm_add_ps (_mm_loadu_ps (det + n), eps);
+            const __m128i bits = _mm_castps_si128 (x);
+            const __m128 e = _mm_cvtepi32_ps (_mm_sub_epi32 (_mm_srli_epi32 (bits, 23), bias));
+            const __m128 t = _mm_sub_ps (_mm_castsi128_ps (_mm_or_si128 (_mm_and_si128 (bits, mantMask), oneBits)), one);
+            __m128 p = _mm_set1_ps (l5);
+            p = _mm_add_ps (_mm_mul_ps (p, t), _mm_set1_ps (l4));
+            p = _mm_add_ps (_mm_mul_ps (p, t), _mm_set1_ps (l3));
+            p = _mm_add_ps (_mm_mul_ps (p, t), _mm_set1_ps (l2));
+            p = _mm_add_ps (_mm_mul_ps (p, t), _mm_set1_ps (l1));
+            const __m128 xDb = _mm_mul_ps (_mm_add_ps (e, _mm_mul_ps (t, p)), _mm_set1_ps (dbPerLog2));
+
+            // curve
+            const __m128 d = _mm_sub_ps (xDb, thresh);
+            __m128 grDb;
+            if constexpr (softKnee)
+            {
+                const __m128 over = _mm_max_ps (_mm_sub_ps (d, halfK), zero);
+                const __m128 c = _mm_min_ps (_mm_max_ps (_mm_add_ps (d, halfK), zero), knee);
+                grDb = _mm_mul_ps (slope, _mm_add_ps (over, _mm_mul_ps (_mm_mul_ps (c, c), invTwoK)));
+            }
+            else
+            {
+                grDb = _mm_mul_ps (slope, _mm_max_ps (d, zero));
+            }
+
+            // exp2 (SSE2 has no floor: truncate, then step down where that rounded up)
+            const __m128 y = _mm_max_ps (minL2, _mm_min_ps (zero, _mm_mul_ps (grDb, _mm_set1_ps (log2PerDb))));
+            __m128i yi = _mm_cvttps_epi32 (y);
+            yi = _mm_add_epi32 (yi, _mm_castps_si128 (_mm_cmpgt_ps (_mm_cvtepi32_ps (yi), y)));
+            const __m128 f = _mm_sub_ps (y, _mm_cvtepi32_ps (yi));
+            __m128 q = _mm_set1_ps (e5);
+            q = _mm_add_ps (_mm_mul_ps (q, f), _mm_set1_ps (e4));
+            q = _mm_add_ps (_mm_mul_ps (q, f), _mm_set1_ps (e3));
+            q = _mm_add_ps (_mm_mul_ps (q, f), _mm_set1_ps (e2));
+            q = _mm_add_ps (_mm_mul_ps (q, f), _mm_set1_ps (e1));
+            q = _mm_add_ps (_mm_mul_ps (q, f), _mm_set1_ps (e0));
+            const __m128 scale = _mm_castsi128_ps (_mm_slli_epi32 (_mm_add_epi32 (yi, bias), 23));
+
+            _mm_storeu_ps (gain + n, _mm_mul_ps (q, scale));
+        }
+
+        processScalar<softKnee> (gc, det + n, gain + n, numSamples - n);
+    }
+
+    template <bool softKnee>
+    GAINCOMPUTER_TARGET_AVX2
+    void processAVX2 (const GainComputer& gc, const float* det, float* gain, int numSamples)
+    {
+        const __m256 eps       = _mm256_set1_ps (GainComputer::detectorEps);
+        const __m256 one       = _mm256_set1_ps (1.0f);
+        const __m256 zero      = _mm256_setzero_ps();
+        const __m256i mantMask = _mm256_set1_epi32 (0x007fffff);
+        const __m256i oneBits  = _mm256_set1_epi32 (0x3f800000);
+        const __m256i bias     = _mm256_set1_epi32 (127);
+        const __m256 thresh    = _mm256_set1_ps (gc.thresholdDb);
+        const __m256 halfK     = _mm256_set1_ps (gc.halfKnee);
+        const __m256 knee      = _mm256_set1_ps (gc.kneeDb);
+        const __m256 slope     = _mm256_set1_ps (gc.slope);
+        const __m256 invTwoK   = _mm256_set1_ps (gc.invTwoKnee);
+        const __m256 minL2     = _mm256_set1_ps (minLog2Gain);
+
+        int n = 0;
+        for (; n + 8 <= numSamples; n += 8)
+        {
+            const __m256 x = _mm256_add_ps (_mm256_loadu_ps (det + n), eps);
+            const __m256i bits = _mm256_castps_si256 (x);
+            const __m256 e = _mm256_cvtepi32_ps (_mm256_sub_epi32 (_mm256_srli_epi32 (bits, 23), bias));
+            const __m256 t = _mm256_sub_ps (_mm256_castsi256_ps (_mm256_or_si256 (_mm256_and_si256 (bits, mantMask), oneBits)), one);
+            __m256 p = _mm256_set1_ps (l5);
+            p = _mm256_add_ps (_mm256_mul_ps (p, t), _mm256_set1_ps (l4));
+            p = _mm256_add_ps (_mm256_mul_ps (p, t), _mm256_set1_ps (l3));
+            p = _mm256_add_ps (_mm256_mul_ps (p, t), _mm256_set1_ps (l2));
+            p = _mm256_add_ps (_mm256_mul_ps (p, t), _mm256_set1_ps (l1));
+            const __m256 xDb = _mm256_mul_ps (_mm256_add_ps (e, _mm256_mul_ps (t, p)), _mm256_set1_ps (dbPerLog2));
+
+            const __m256 d = _mm256_sub_ps (xDb, thresh);
+            __m256 grDb;
+            if constexpr (softKnee)
+            {
+                const __m256 over = _mm256_max_ps (_mm256_sub_ps (d, halfK), zero);
+                const __m256 c = _mm256_min_ps (_mm256_max_ps (_mm256_add_ps (d, halfK), zero), knee);
+                grDb = _mm256_mul_ps (slope, _mm256_add_ps (over, _mm256_mul_ps (_mm256_mul_ps (c, c), invTwoK)));
+            }
+            else
+            {
+                grDb = _mm256_mul_ps (slope, _mm256_max_ps (d, zero));
+            }
+
+            const __m256 y = _mm256_max_ps (minL2, _mm256_min_ps (zero, _mm256_mul_ps (grDb, _mm256_set1_ps (log2PerDb))));
+            const __m256 fy = _mm256_floor_ps (y);
+            const __m256 f = _mm256_sub_ps (y, fy);
+            __m256 q = _mm256_set1_ps (e5);
+            q = _mm256_add_ps (_mm256_mul_ps (q, f), _mm256_set1_ps (e4));
+            q = _mm256_add_ps (_mm256_mul_ps (q, f), _mm256_set1_ps (e3));
+            q = _mm256_add_ps (_mm256_mul_ps (q, f), _mm256_set1_ps (e2));
+            q = _mm256_add_ps (_mm256_mul_ps (q, f), _mm256_set1_ps (e1));
+            q = _mm256_add_ps (_mm256_mul_ps (q, f), _mm256_set1_ps (e0));
+            const __m256 scale = _mm256_castsi256_ps (_mm256_slli_epi32 (_mm256_add_epi32 (_mm256_cvtps_epi32 (fy), bias), 23));
+
+            _mm256_storeu_ps (gain + n, _mm256_mul_ps (q, scale));
+        }
+
+        processScalar<softKnee> (gc, det + n, gain + n, numSamples - n);
+    }
+
+    bool cpuHasAVX2()
+    {
+       #if defined(_MSC_VER) && ! defined(__clang__)
+        int info[4] = {};
+        __cpuid (info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx     = (info[2] & (1 << 28)) != 0;
+        if (! (osxsave && avx) || (_xgetbv (0) & 0x6) != 0x6)
+            return false;
+        __cpuidex (info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+       #else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports ("avx2");
+       #endif
+    }
+   #endif
+
+   #if GAINCOMPUTER_NEON
+    template <bool softKnee>
+    void processNEON (const GainComputer& gc, const float* det, float* gain, int numSamples)
+    {
+        const float32x4_t eps      = vdupq_n_f32 (GainComputer::detectorEps);
+        const float32x4_t one      = vdupq_n_f32 (1.0f);
+        const float32x4_t zero     = vdupq_n_f32 (0.0f);
+        const uint32x4_t mantMask  = vdupq_n_u32 (0x007fffffu);
+        const uint32x4_t oneBits   = vdupq_n_u32 (0x3f800000u);
+        const int32x4_t bias       = vdupq_n_s32 (127);
+        const float32x4_t thresh   = vdupq_n_f32 (gc.thresholdDb);
+        const float32x4_t halfK    = vdupq_n_f32 (gc.halfKnee);
+        const float32x4_t knee     = vdupq_n_f32 (gc.kneeDb);
+        const float32x4_t slope    = vdupq_n_f32 (gc.slope);
+        const float32x4_t invTwoK  = vdupq_n_f32 (gc.invTwoKnee);
+        const float32x4_t minL2    = vdupq_n_f32 (minLog2Gain);
+
+        int n = 0;
+        for (; n + 4 <= numSamples; n += 4)
+        {
+            const float32x4_t x = vaddq_f32 (vld1q_f32 (det + n), eps);
+            const uint32x4_t bits = vreinterpretq_u32_f32 (x);
+            const float32x4_t e = vcvtq_f32_s32 (vsubq_s32 (vreinterpretq_s32_u32 (vshrq_n_u32 (bits, 23)), bias));
+            const float32x4_t t = vsubq_f32 (vreinterpretq_f32_u32 (vorrq_u32 (vandq_u32 (bits, mantMask), oneBits)), one);
+            float32x4_t p = vdupq_n_f32 (l5);
+            p = vmlaq_f32 (vdupq_n_f32 (l4), p, t);
+            p = vmlaq_f32 (vdupq_n_f32 (l3), p, t);
+            p = vmlaq_f32 (vdupq_n_f32 (l2), p, t);
+            p = vmlaq_f32 (vdupq_n_f32 (l1), p, t);
+            const float32x4_t xDb = vmulq_n_f32 (vmlaq_f32 (e, t, p), dbPerLog2);
+
+            const float32x4_t d = vsubq_f32 (xDb, thresh);
+            float32x4_t grDb;
+            if constexpr (softKnee)
+            {
+                const float32x4_t over = vmaxq_f32 (vsubq_f32 (d, halfK), zero);
+                const float32x4_t c = vminq_f32 (vmaxq_f32 (vaddq_f32 (d, halfK), zero), knee);
+                grDb = vmulq_f32 (slope, vmlaq_f32 (over, vmulq_f32 (c, c), invTwoK));
+            }
+            else
+            {
+                grDb = vmulq_f32 (slope, vmaxq_f32 (d, zero));
+            }
+
+            // truncate, then step down where that rounded up (same as the SSE2 path)
+            const float32x4_t y = vmaxq_f32 (minL2, vminq_f32 (zero, vmulq_n_f32 (grDb, log2PerDb)));
+            int32x4_t yi = vcvtq_s32_f32 (y);
+            yi = vaddq_s32 (yi, vreinterpretq_s32_u32 (vcgtq_f32 (vcvtq_f32_s32 (yi), y)));
+            const float32x4_t f = vsubq_f32 (y, vcvtq_f32_s32 (yi));
+            float32x4_t q = vdupq_n_f32 (e5);
+            q = vmlaq_f32 (vdupq_n_f32 (e4), q, f);
+            q = vmlaq_f32 (vdupq_n_f32 (e3), q, f);
+            q = vmlaq_f32 (vdupq_n_f32 (e2), q, f);
+            q = vmlaq_f32 (vdupq_n_f32 (e1), q, f);
+            q = vmlaq_f32 (vdupq_n_f32 (e0), q, f);
+            const float32x4_t scale = vreinterpretq_f32_s32 (vshlq_n_s32 (vaddq_s32 (yi, bias), 23));
+
+            vst1q_f32 (gain + n, vmulq_f32 (q, scale));
+        }
+
+        processScalar<softKnee> (gc, det + n, gain + n, numSamples - n);
+    }
+   #endif
+
+    using Kernel = void (*) (const GainComputer&, const float*, float*, int);
+
+    struct KernelChoice
+    {
+        Kernel soft, hard;
+        const char* name;
+    };
+
+    // Every kernel this CPU can run, the one process() uses first; scalar is always last
+    struct KernelList
+    {
+        KernelChoice kernels[3];
+        int num = 0;
+
+        void add (KernelChoice k) noexcept { kernels[num++] = k; }
+    };
+
+    KernelList listKernels()
+    {
+        KernelList list;
+       #if GAINCOMPUTER_X86
+        if (cpuHasAVX2())
+            list.add ({ processAVX2<true>, processAVX2<false>, "avx2" });
+        list.add ({ processSSE2<true>, processSSE2<false>, "sse2" });
+       #elif GAINCOMPUTER_NEON
+        list.add ({ processNEON<true>, processNEON<false>, "neon" });
+       #endif
+        list.add ({ processScalar<true>, processScalar<false>, "scalar" });
+        return list;
+    }
+
+    const KernelList& getKernels()
+    {
+        static const KernelList list = listKernels(); // resolved once, on first use
+        return list;
+    }
+
+    // ---- GainCurveTable lookups ----
+    using TableKernel = void (*) (const GainCurveTable&, const float*, float*, int);
+
+    void lookupScalar (const GainCurveTable& t, const float* det, float* gain, int numSamples)
+    {
+        for (int n = 0; n < numSamples; ++n)
+            gain[n] = t.getGain (det[n]);
+    }
+
+   #if GAINCOMPUTER_X86
+    GAINCOMPUTER_TARGET_AVX2
+    void lookupAVX2 (const GainCurveTable& t, const float* det, float* gain, int numSamples)
+    {
+        const __m256 lo        = _mm256_set1_ps (t.minLevel);
+        const __m256 hi        = _mm256_set1_ps (t.maxLevel);
+        const __m256i mask     = _mm256_set1_epi32 ((int) GainCurveTable::fractionMask);
+        const __m256i first    = _mm256_set1_epi32 ((int) t.firstIndex);
+        const __m256 fracScale = _mm256_set1_ps (GainCurveTable::fractionScale);
+        const float* table     = t.table.data();
+
+        int n = 0;
+        for (; n + 8 <= numSamples; n += 8)
+        {
+            // max(x, lo) returns lo for NaN, like the scalar path
+            const __m256 x = _mm256_min_ps (_mm256_max_ps (_mm256_loadu_ps (det + n), lo), hi);
+            const __m256i bits = _mm256_castps_si256 (x);
+
+            const __m256i index = _mm256_sub_epi32 (_mm256_srli_epi32 (bits, GainCurveTable::fractionBits), first);
+            const __m256 frac = _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_and_si256 (bits, mask)), fracScale);
+
+            const __m256 g0 = _mm256_i32gather_ps (table, index, 4);
+            const __m256 g1 = _mm256_i32gather_ps (table + 1, index, 4);
+            _mm256_storeu_ps (gain + n, _mm256_add_ps (g0, _mm256_mul_ps (frac, _mm256_sub_ps (g1, g0))));
+        }
+
+        lookupScalar (t, det + n, gain + n, numSamples - n);
+    }
+   #endif
+
+    TableKernel chooseTableKernel()
+    {
+       #if GAINCOMPUTER_X86
+        if (cpuHasAVX2())
+            return lookupAVX2;
+       #endif
+        return lookupScalar; // no gather before AVX2 / on NEON: the scalar loop is already cheap
+    }
+
+    const KernelChoice& getKernel()
+    {
+        return getKernels().kernels[0];
+    }
+}
+
+void GainComputer::process (const float* detector, float* gain, int numSamples) const
+{
+    const auto& kernel = getKernel();
+    (kneeDb > 0.0f ? kernel.soft : kernel.hard) (*this, detector, gain, numSamples);
+}
+
+void GainComputer::processGeneral (const float* detector, float* gain, int numSamples) const
+{
+    getKernel().soft (*this, detector, gain, numSamples);
+}
+
+int GainComputer::getNumKernels()
+{
+    return getKernels().num;
+}
+
+const char* GainComputer::getKernelName (int kernel)
+{
+    return getKernels().kernels[std::clamp (kernel, 0, getKernels().num - 1)].name;
+}
+
+float GainComputer::measureMaxErrorDb (int kernel)
+{
+    const auto& k = getKernels().kernels[std::clamp (kernel, 0, getKernels().num - 1)];
+
+    constexpr float ratios[] = { 1.5f, 3.0f, 4.0f, 6.0f, 10.0f, 20.0f };
+    constexpr int numLevels = 1024;
+
+    float levels[numLevels], fast[numLevels];
+    for (int i = 0; i < numLevels; ++i)
+        levels[i] = std::pow (10.0f, (-90.0f + 102.0f * (float) i / (float) (numLevels - 1)) * 0.05f);
+
+    float worst = 0.0f;
+    GainComputer gc;
+
+    for (float t = -60.0f; t <= 0.0f; t += 1.0f)
+        for (float r : ratios)
+            for (float knee = 0.0f; knee <= 12.0f; knee += 0.5f)
+            {
+                gc.setParameters (t, r, knee);
+                (knee > 0.0f ? k.soft : k.hard) (gc, levels, fast, numLevels); // as process() picks
+
+                for (int i = 0; i < numLevels; ++i)
+                {
+                    const float inDb = 20.0f * std::log10 (levels[i] + detectorEps);
+                    const float refDb = referenceGainReductionDb (inDb, t, r, knee);
+                    worst = std::max (worst, std::abs (20.0f * std::log10 (fast[i]) - refDb));
+                }
+            }
+
+    return worst;
+}
+
+//==============================================================================
+GainCurveTable::GainCurveTable (float t, float r, float k)
+    : thresholdDb (t), ratio (r), kneeDb (k > 0.0f ? k : 0.0f)
+{
+    // first octave boundary at least an octave below the knee, so table[0] is unity gain
+    const int minExponent = (int) std::floor ((thresholdDb - 0.5f * kneeDb) / dbPerLog2) - 1;
+
+    firstIndex = (uint32_t) (127 + minExponent) << segmentBits;
+    minLevel = std::ldexp (1.0f, minExponent);
+    maxLevel = std::nextafter (std::ldexp (1.0f, minExponent + numOctaves), 0.0f); // last segment, frac ~1
+
+    // entry i sits on the segment boundary 2^e * (1 + m / 256); exact curve, evaluated in double
+    table.resize ((size_t) numEntries);
+    for (int i = 0; i < numEntries; ++i)
+    {
+        const int e = minExponent + (i >> segmentBits);
+        const int m = i & ((1 << segmentBits) - 1);
+        const double level = std::ldexp (1.0 + (double) m / (double) (1 << segmentBits), e);
+
+        const float grDb = GainComputer::referenceGainReductionDb ((float) (20.0 * std::log10 (level)), thresholdDb, ratio, kneeDb);
+        table[(size_t) i] = (float) std::pow (10.0, (double) grDb * 0.05);
+    }
+}
+
+void GainCurveTable::process (const float* detector, float* gain, int numSamples) const
+{
+    static const TableKernel kernel = chooseTableKernel();
+    kernel (*this, detector, gain, numSamples);
+}
+
+float GainCurveTable::getGainDb (float inputDb) const noexcept
+{
+    return 20.0f * std::log10 (std::max (1.0e-9f, getGain (std::pow (10.0f, inputDb * 0.05f))));
+}
+
+float GainCurveTable::measureMaxErrorDb()
+{
+    constexpr float ratios[] = { 1.5f, 3.0f, 4.0f, 6.0f, 10.0f, 20.0f };
+    constexpr int numLevels = 1024;
+
+    float levels[numLevels], gains[numLevels];
+    for (int i = 0; i < numLevels; ++i)
+        levels[i] = std::pow (10.0f, (-90.0f + 102.0f * (float) i / (float) (numLevels - 1)) * 0.05f);
+
+    float worst = 0.0f;
+
+    for (float t = -60.0f; t <= 0.0f; t += 1.0f)
+        for (float r : ratios)
+            for (float k = 0.0f; k <= 12.0f; k += 0.5f)
+            {
+                const GainCurveTable table (t, r, k);
+                table.process (levels, gains, numLevels);
+
+                for (int i = 0; i < numLevels; ++i)
+                {
+                    const float inDb = 20.0f * std::log10 (levels[i]);
+                    const float refDb = GainComputer::referenceGainReductionDb (inDb, t, r, k);
+                    worst = std::max (worst, std::abs (20.0f * std::log10 (gains[i]) - refDb));
+                }
+            }
+
+    return worst;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "Publisher.h"
+
+// Static compressor curve (threshold / ratio / knee) evaluated a whole block at a time.
+// Input is the linear detector level, output is the linear gain to multiply the audio by.
+//
+// process() uses fast log2/exp2 approximations and picks an SSE2 / AVX2 / NEON kernel at runtime,
+// in a soft-knee and a (cheaper, same result at knee 0) hard-knee version.
+// The approximations are good to about 1e-4 dB over the full parameter range
+// (log2: |err| < 1.7e-5, exp2: relative err < 8e-8); measureMaxErrorDb() checks it, and the
+// regression tool fails if it comes out above maxErrorDb.
+// processReference() is the exact scalar version (log10/pow), same math as the old per-sample lambda;
+// it and referenceGainReductionDb() are templated so the double-precision path can use them too.
+struct GainComputer
+{
+    void setParameters (float newThresholdDb, float newRatio, float newKneeDb)
+    {
+        thresholdDb = newThresholdDb;
+        ratio       = newRatio;
+        kneeDb      = newKneeDb > 0.0f ? newKneeDb : 0.0f;
+
+        slope      = 1.0f / ratio - 1.0f;
+        halfKnee   = 0.5f * kneeDb;
+        invTwoKnee = kneeDb > 0.0f ? 1.0f / (2.0f * kneeDb) : 0.0f; // hard knee: the knee term is always 0
+    }
+
+    void process (const float* detector, float* gain, int numSamples) const; // in-place is fine
+
+    // The soft-knee kernel whatever the knee (what process() runs for knee > 0). Same output as process();
+    // only there so the benchmark can price the hard-knee specialisation.
+    void processGeneral (const float* detector, float* gain, int numSamples) const;
+
+    template <typename Sample>
+    void processReference (const Sample* detector, Sample* gain, int numSamples) const
+    {
+        for (int n = 0; n < numSamples; ++n)
+        {
+            // same as juce::Decibels (-100 dB floor), kept here so this file has no JUCE dependency
+            const Sample level = detector[n] + Sample (detectorEps);
+            const Sample detDb = level > Sample (0) ? std::max (Sample (-100), std::log10 (level) * Sample (20)) : Sample (-100);
+            const Sample grDb = referenceGainReductionDb (detDb, (Sample) thresholdDb, (Sample) ratio, (Sample) kneeDb);
+            gain[n] = grDb > Sample (-100) ? std::pow (Sample (10), grDb * Sample (0.05)) : Sample (0);
+        }
+    }
+
+    // exact gain reduction in dB (<= 0) for a detector level in dB
+    template <typename Sample>
+    static Sample referenceGainReductionDb (Sample inLevelDb, Sample thresholdDb, Sample ratio, Sample kneeDb)
+    {
+        const Sample x = inLevelDb;
+        const Sample T = thresholdDb;
+        const Sample R = ratio;
+
+        if (kneeDb <= Sample (0))
+        {
+            if (x <= T) return Sample (0);
+            const Sample y = T + (x - T) / R;
+            return (y - x);
+        }
+
+        const Sample halfK = Sample (0.5) * kneeDb;
+
+        if (x < (T - halfK)) return Sample (0);
+
+        if (x > (T + halfK))
+        {
+            const Sample y = T + (x - T) / R;
+            return (y - x);
+        }
+
+        const Sample d = x - (T - halfK);
+        const Sample y = x + (Sample (1) / R - Sample (1)) * (d * d) / (Sample (2) * kneeDb);
+        return (y - x);
+    }
+
+    // Kernels this CPU can run, 0 being the one process() uses and the last the scalar one
+    static int getNumKernels();
+    static const char* getKernelName (int kernel = 0); // "avx2", "sse2", "neon" or "scalar"
+
+    // worst |fast - reference| in dB over threshold -60..0, every ratio choice, knee 0..12, detector -90..+12 dB,
+    // for one of the kernels above
+    static float measureMaxErrorDb (int kernel = 0);
+    static constexpr float maxErrorDb = 2.0e-4f; // what measureMaxErrorDb() has to stay under (~1e-4 measured)
+
+    static constexpr float detectorEps = 1.0e-9f; // keeps log2 away from zero
+
+    float thresholdDb = -18.0f;
+    float ratio       = 4.0f;
+    float kneeDb      = 6.0f;
+
+    // derived, used by the kernels
+    float slope      = 1.0f / 4.0f - 1.0f;
+    float halfKnee   = 3.0f;
+    float invTwoKnee = 1.0f / 12.0f;
+};
+
+// The same curve tabulated for one threshold / ratio / knee: detector level (linear) -> linear gain.
+//
+// Indexed straight from the float's bits: exponent + top 8 mantissa bits pick the segment
+// (256 per octave, ~0.024 dB wide), the remaining mantissa bits are the interpolation fraction.
+// A lookup is a shift, a mask, two loads and a multiply-add (an AVX2 gather when available),
+// no log / exp at all. The table starts an octave below the knee and spans 18 octaves
+// (108 dB); levels below get exactly the table's first entry (unity gain), levels above are
+// clamped to the last one.
+// Max error is ~6e-3 dB, at the corner of a hard knee (elsewhere ~1e-4 dB); measureMaxErrorDb()
+// checks it against referenceGainReductionDb() on the same grid as GainComputer (bound: maxErrorDb).
+//
+// Immutable once built (on the message thread); GainCurvePublisher hands it to the audio thread.
+class GainCurveTable
+{
+public:
+    GainCurveTable (float thresholdDb, float ratio, float kneeDb);
+
+    bool matches (float t, float r, float k) const noexcept
+    {
+        return t == thresholdDb && r == ratio && (k > 0.0f ? k : 0.0f) == kneeDb;
+    }
+
+    float getGain (float detector) const noexcept
+    {
+        detector = detector > minLevel ? detector : minLevel; // also catches NaN
+        detector = detector < maxLevel ? detector : maxLevel;
+
+        uint32_t bits;
+        std::memcpy (&bits, &detector, sizeof (bits));
+
+        const float* g = table.data() + ((bits >> fractionBits) - firstIndex);
+        const float frac = (float) (bits & fractionMask) * fractionScale;
+        return g[0] + frac * (g[1] - g[0]);
+    }
+
+    void process (const float* detector, float* gain, int numSamples) const; // in-place is fine
+
+    // For displays: gain change in dB (<= 0) for an input level in dB, through the table
+    float getGainDb (float inputDb) const noexcept;
+
+    static float measureMaxErrorDb();
+    static constexpr float maxErrorDb = 1.0e-2f; // the bound measureMaxErrorDb() is held to (~6e-3 measured)
+
+    const float thresholdDb, ratio, kneeDb;
+
+    static constexpr int segmentBits  = 8;
+    static constexpr int fractionBits = 23 - segmentBits;
+    static constexpr uint32_t fractionMask = (1u << fractionBits) - 1u;
+    static constexpr float fractionScale = 1.0f / (float) (1u << fractionBits);
+    static constexpr int numOctaves = 18;
+    static constexpr int numEntries = (numOctaves << segmentBits) + 1;
+
+    // set by the constructor from the knee position
+    uint32_t firstIndex = 0; // (biased exponent << segmentBits) of table[0]
+    float minLevel = 0.0f, maxLevel = 0.0f;
+    std::vector<float> table;
+};
+
+// The current table, from the message thread (which builds and frees them) to the audio thread
+using GainCurvePublisher = Publisher<GainCurveTable>;
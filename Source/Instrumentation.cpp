@@ -0,0 +1,106 @@
+#include "Instrumentation.h"
+
+#if STEREOCOMP_RT_TRAPS
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#ifdef _MSC_VER
+ #include <malloc.h>
+#endif
+
+// The flag lives per thread: only the thread inside processBlock is checked, and an allocation that
+// processBlock's own callees make on another thread isn't its business.
+namespace
+{
+    thread_local bool inRealtimeContext = false;
+    std::atomic<uint64_t> numViolations { 0 };
+}
+
+namespace RealtimeTraps
+{
+    bool isInRealtimeContext() noexcept { return inRealtimeContext; }
+    uint64_t getNumRealtimeViolations() noexcept { return numViolations.load (std::memory_order_relaxed); }
+
+    ScopedRealtimeContext::ScopedRealtimeContext() noexcept  { inRealtimeContext = true; }
+    ScopedRealtimeContext::~ScopedRealtimeContext()          { inRealtimeContext = false; }
+}
+
+#if ! STEREOCOMP_RTSAN // RealtimeSanitizer intercepts malloc itself (and locks, and system calls)
+namespace
+{
+    void trapAllocation (const char* what)
+    {
+        numViolations.fetch_add (1, std::memory_order_relaxed);
+
+        inRealtimeContext = false; // reporting below may allocate
+        std::fprintf (stderr, "StereoCompressor: %s on the audio thread\n", what);
+        assert (false && "heap allocation on the audio thread");
+        inRealtimeContext = true;
+    }
+
+    void* allocate (std::size_t size)
+    {
+        if (inRealtimeContext)
+            trapAllocation ("operator new");
+
+        if (void* p = std::malloc (size > 0 ? size : 1))
+            return p;
+        throw std::bad_alloc();
+    }
+
+    void deallocate (void* p) noexcept
+    {
+        if (p != nullptr && inRealtimeContext)
+            trapAllocation ("operator delete");
+        std::free (p);
+    }
+
+    // Over-aligned types (alignas above the default, e.g. Lanes4 members) come through these
+    void* allocateAligned (std::size_t size, std::align_val_t alignment)
+    {
+        if (inRealtimeContext)
+            trapAllocation ("aligned operator new");
+
+        const auto align = (std::size_t) alignment;
+        const auto rounded = ((size > 0 ? size : 1) + align - 1) / align * align; // aligned_alloc wants a multiple
+       #ifdef _MSC_VER
+        if (void* p = _aligned_malloc (rounded, align))
+       #else
+        if (void* p = std::aligned_alloc (align, rounded))
+       #endif
+            return p;
+        throw std::bad_alloc();
+    }
+
+    void deallocateAligned (void* p) noexcept
+    {
+        if (p != nullptr && inRealtimeContext)
+            trapAllocation ("aligned operator delete");
+       #ifdef _MSC_VER
+        _aligned_free (p);
+       #else
+        std::free (p);
+       #endif
+    }
+}
+
+void* operator new (std::size_t size)                                 { return allocate (size); }
+void* operator new[] (std::size_t size)                               { return allocate (size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept { try { return allocate (size); } catch (...) { return nullptr; } }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { try { return allocate (size); } catch (...) { return nullptr; } }
+void operator delete (void* p) noexcept                               { deallocate (p); }
+void operator delete[] (void* p) noexcept                             { deallocate (p); }
+void operator delete (void* p, std::size_t) noexcept                  { deallocate (p); }
+void operator delete[] (void* p, std::size_t) noexcept                { deallocate (p); }
+
+void* operator new (std::size_t size, std::align_val_t a)                                    { return allocateAligned (size, a); }
+void* operator new[] (std::size_t size, std::align_val_t a)                                  { return allocateAligned (size, a); }
+void* operator new (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept   { try { return allocateAligned (size, a); } catch (...) { return nullptr; } }
+void* operator new[] (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept { try { return allocateAligned (size, a); } catch (...) { return nullptr; } }
+void operator delete (void* p, std::align_val_t) noexcept                                   { deallocateAligned (p); }
+void operator delete[] (void* p, std::align_val_t) noexcept                                 { deallocateAligned (p); }
+void operator delete (void* p, std::size_t, std::align_val_t) noexcept                      { deallocateAligned (p); }
+void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept                    { deallocateAligned (p); }
+#endif
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Audio-thread instrumentation.
+//
+// STEREOCOMP_INSTRUMENTATION (set by CMake: on in Debug, or everywhere with the option) builds an
+// AudioThreadMonitor into the processor: the duration of every processBlock call goes into a log-scale
+// histogram, calls over a fraction of the buffer's real-time deadline are counted, and the output is
+// scanned for NaN / Inf and denormals. With it at 0 none of this is compiled.
+//
+// STEREOCOMP_RT_TRAPS (Debug only) traps what the audio thread must never do. With RealtimeSanitizer
+// (Clang's -fsanitize=realtime, STEREOCOMP_RTSAN, the default wherever the compiler has it) every
+// allocation, lock and blocking system call made inside processBlock aborts with a stack trace. Without
+// it Instrumentation.cpp replaces operator new / delete (plain, nothrow and std::align_val_t) and catches
+// the allocations: they're counted (getNumRealtimeViolations) and assert in a debugger. That fallback
+// doesn't see malloc, locks or system calls. It also only fires where the replacement is the operator new
+// the code binds to: in a plugin dlopen'd on Linux the global one resolves to the host's libstdc++, so
+// there it catches nothing - use the command line tools (or macOS / Windows) for that check.
+
+#ifndef STEREOCOMP_INSTRUMENTATION
+ #define STEREOCOMP_INSTRUMENTATION 0
+#endif
+
+#ifndef STEREOCOMP_RT_TRAPS
+ #define STEREOCOMP_RT_TRAPS 0
+#endif
+
+#ifndef STEREOCOMP_RTSAN
+ #define STEREOCOMP_RTSAN 0
+#endif
+
+// Marks a function as a real-time context for RealtimeSanitizer; nothing otherwise
+#if STEREOCOMP_RTSAN
+ #define STEREOCOMP_NONBLOCKING [[clang::nonblocking]]
+#else
+ #define STEREOCOMP_NONBLOCKING
+#endif
+
+#if STEREOCOMP_RT_TRAPS
+namespace RealtimeTraps
+{
+    // Set for the duration of processBlock on the calling thread (see ScopedRealtimeContext)
+    bool isInRealtimeContext() noexcept;
+    uint64_t getNumRealtimeViolations() noexcept;
+
+    struct ScopedRealtimeContext
+    {
+        ScopedRealtimeContext() noexcept;
+        ~ScopedRealtimeContext();
+        ScopedRealtimeContext (const ScopedRealtimeContext&) = delete;
+        ScopedRealtimeContext& operator= (const ScopedRealtimeContext&) = delete;
+    };
+}
+#endif
+
+#if STEREOCOMP_INSTRUMENTATION
+// One writer (the audio thread), any number of readers. Every counter is a relaxed atomic written with a
+// plain load + store, so recording a block is a handful of uncontended stores and never waits.
+class AudioThreadMonitor
+{
+public:
+    // Quarter-octave buckets from 256 ns; the last one also takes everything longer (~17 ms and up)
+    static constexpr int bucketsPerOctave = 4;
+    static constexpr int firstOctave = 8;
+    static constexpr int numBuckets = 64;
+
+    static double getBucketUpperNs (int bucket) noexcept
+    {
+        return std::ldexp (1.0 + (bucket % bucketsPerOctave + 1) / (double) bucketsPerOctave,
+                           firstOctave + bucket / bucketsPerOctave);
+    }
+
+    struct Stats
+    {
+        uint64_t numBlocks = 0;
+        uint64_t numOverDeadline = 0;     // calls longer than deadlineFraction x the buffer's duration
+        uint64_t nonFiniteSamples = 0;    // NaN / Inf in the output
+        uint64_t denormalSamples = 0;
+        uint64_t blocksWithNonFinite = 0;
+        uint64_t realtimeViolations = 0;  // allocations trapped on the audio thread (STEREOCOMP_RT_TRAPS)
+        double totalNs = 0.0, maxNs = 0.0;
+        double deadlineFraction = 0.0;
+        uint64_t histogram[numBuckets] {};
+
+        double getMeanNs() const noexcept { return numBlocks > 0 ? totalNs / (double) numBlocks : 0.0; }
+
+        // Upper edge of the bucket holding the p-th percentile (p in 0..1)
+        double getPercentileNs (double p) const noexcept
+        {
+            const auto target = (uint64_t) std::ceil (p * (double) numBlocks);
+            uint64_t seen = 0;
+            for (int b = 0; b < numBuckets; ++b)
+                if ((seen += histogram[b]) >= target && seen > 0)
+                    return b == numBuckets - 1 ? maxNs : getBucketUpperNs (b);
+            return 0.0;
+        }
+
+        void merge (const Stats& other) noexcept
+        {
+            numBlocks += other.numBlocks;
+            numOverDeadline += other.numOverDeadline;
+            nonFiniteSamples += other.nonFiniteSamples;
+            denormalSamples += other.denormalSamples;
+            blocksWithNonFinite += other.blocksWithNonFinite;
+            realtimeViolations = std::max (realtimeViolations, other.realtimeViolations); // process-wide counter
+            totalNs += other.totalNs;
+            maxNs = std::max (maxNs, other.maxNs);
+            deadlineFraction = other.deadlineFraction;
+            for (int b = 0; b < numBuckets; ++b)
+                histogram[b] += other.histogram[b];
+        }
+    };
+
+    // Message thread (prepareToPlay)
+    void prepare (double newSampleRate) noexcept { sampleRate.store (newSampleRate, std::memory_order_relaxed); }
+    void setDeadlineFraction (double fraction) noexcept { deadlineFraction.store (fraction, std::memory_order_relaxed); }
+
+    // Not while the audio thread is recording, or the counts it's in the middle of updating survive
+    void reset() noexcept
+    {
+        for (auto* c : { &numBlocks, &numOverDeadline, &nonFiniteSamples, &denormalSamples, &blocksWithNonFinite })
+            c->store (0, std::memory_order_relaxed);
+        for (auto& h : histogram)
+            h.store (0, std::memory_order_relaxed);
+        totalNs.store (0.0, std::memory_order_relaxed);
+        maxNs.store (0.0, std::memory_order_relaxed);
+    }
+
+    // Audio thread
+    static int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void recordBlock (int64_t startNs, int numSamples) noexcept
+    {
+        const double ns = (double) (now() - startNs);
+
+        increment (numBlocks);
+        increment (histogram[bucketFor (ns)]);
+        totalNs.store (totalNs.load (std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > maxNs.load (std::memory_order_relaxed))
+            maxNs.store (ns, std::memory_order_relaxed);
+
+        const double rate = sampleRate.load (std::memory_order_relaxed);
+        if (rate > 0.0 && ns > deadlineFraction.load (std::memory_order_relaxed) * 1.0e9 * numSamples / rate)
+            increment (numOverDeadline);
+    }
+
+    template <typename Sample>
+    void checkOutput (const Sample* x, int numSamples) noexcept
+    {
+        uint64_t nonFinite = 0, denormal = 0;
+        for (int n = 0; n < numSamples; ++n)
+        {
+            const Sample a = std::abs (x[n]);
+            nonFinite += ! (a <= std::numeric_limits<Sample>::max()); // NaN fails every comparison
+            denormal  += a != Sample (0) && a < std::numeric_limits<Sample>::min();
+        }
+
+        if (nonFinite > 0)
+        {
+            add (nonFiniteSamples, nonFinite);
+            increment (blocksWithNonFinite);
+        }
+        if (denormal > 0)
+            add (denormalSamples, denormal);
+    }
+
+    // Any thread; the fields may be from slightly different moments
+    Stats getStats() const noexcept
+    {
+        Stats s;
+        s.numBlocks = numBlocks.load (std::memory_order_relaxed);
+        s.numOverDeadline = numOverDeadline.load (std::memory_order_relaxed);
+        s.nonFiniteSamples = nonFiniteSamples.load (std::memory_order_relaxed);
+        s.denormalSamples = denormalSamples.load (std::memory_order_relaxed);
+        s.blocksWithNonFinite = blocksWithNonFinite.load (std::memory_order_relaxed);
+       #if STEREOCOMP_RT_TRAPS
+        s.realtimeViolations = RealtimeTraps::getNumRealtimeViolations();
+       #endif
+        s.totalNs = totalNs.load (std::memory_order_relaxed);
+        s.maxNs = maxNs.load (std::memory_order_relaxed);
+        s.deadlineFraction = deadlineFraction.load (std::memory_order_relaxed);
+        for (int b = 0; b < numBuckets; ++b)
+            s.histogram[b] = histogram[b].load (std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    static int bucketFor (double ns) noexcept
+    {
+        if (ns < std::ldexp (1.0, firstOctave))
+            return 0;
+        int exponent;
+        const double mantissa = std::frexp (ns, &exponent); // ns = mantissa * 2^exponent, mantissa in [0.5, 1)
+        const int b = (exponent - 1 - firstOctave) * bucketsPerOctave + (int) ((mantissa * 2.0 - 1.0) * bucketsPerOctave);
+        return b < numBuckets ? b : numBuckets - 1;
+    }
+
+    static void increment (std::atomic<uint64_t>& c) noexcept { add (c, 1); }
+    static void add (std::atomic<uint64_t>& c, uint64_t v) noexcept
+    {
+        c.store (c.load (std::memory_order_relaxed) + v, std::memory_order_relaxed); // single writer
+    }
+
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<double> deadlineFraction { 0.5 };
+
+    std::atomic<uint64_t> numBlocks { 0 }, numOverDeadline { 0 };
+    std::atomic<uint64_t> nonFiniteSamples { 0 }, denormalSamples { 0 }, blocksWithNonFinite { 0 };
+    std::atomic<double> totalNs { 0.0 }, maxNs { 0.0 };
+    std::atomic<uint64_t> histogram[numBuckets] {};
+};
+#endif
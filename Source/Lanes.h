@@ -0,0 +1,108 @@
+#pragma once
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #define LANES_SSE2 1
+ #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+ #define LANES_NEON 1
+ #include <arm_neon.h>
+#endif
+
+// Four float lanes in one register (SSE2 on x86, NEON on AArch64, a plain array anywhere else).
+// Only what the detector's paired-channel loop and StreamBatch need, and every operation is the
+// plain IEEE one on each lane (no FMA, no approximate sqrt), so a lane gives the same bits as the
+// scalar expression it replaces - as long as the compiler doesn't contract either side into an FMA,
+// which CMakeLists.txt turns off (-ffp-contract=off) for every target that compiles this.
+struct Lanes4
+{
+   #if LANES_SSE2
+    __m128 v;
+
+    static Lanes4 load (const float* p) noexcept            { return { _mm_loadu_ps (p) }; }
+    void store (float* p) const noexcept                    { _mm_storeu_ps (p, v); }
+    static Lanes4 set (float a, float b) noexcept           { return { _mm_setr_ps (a, b, 0.0f, 0.0f) }; }
+    static Lanes4 set (float a, float b, float c, float d) noexcept { return { _mm_setr_ps (a, b, c, d) }; }
+    static Lanes4 fill (float a) noexcept                   { return { _mm_set1_ps (a) }; }
+
+    friend Lanes4 operator+ (Lanes4 a, Lanes4 b) noexcept   { return { _mm_add_ps (a.v, b.v) }; }
+    friend Lanes4 operator- (Lanes4 a, Lanes4 b) noexcept   { return { _mm_sub_ps (a.v, b.v) }; }
+    friend Lanes4 operator* (Lanes4 a, Lanes4 b) noexcept   { return { _mm_mul_ps (a.v, b.v) }; }
+
+    static Lanes4 abs (Lanes4 a) noexcept                   { return { _mm_andnot_ps (_mm_set1_ps (-0.0f), a.v) }; }
+    static Lanes4 sqrt (Lanes4 a) noexcept                  { return { _mm_sqrt_ps (a.v) }; }
+    static Lanes4 max (Lanes4 a, Lanes4 b) noexcept         { return { _mm_max_ps (a.v, b.v) }; } // a > b ? a : b, i.e. std::max (b, a)
+
+    // lanes 0 <-> 1 and 2 <-> 3 / lane 0 everywhere
+    static Lanes4 swapPairs (Lanes4 a) noexcept             { return { _mm_shuffle_ps (a.v, a.v, _MM_SHUFFLE (2, 3, 0, 1)) }; }
+    static Lanes4 broadcast0 (Lanes4 a) noexcept            { return { _mm_shuffle_ps (a.v, a.v, 0) }; }
+
+    // per lane: a > b ? x : y
+    static Lanes4 selectGreater (Lanes4 a, Lanes4 b, Lanes4 x, Lanes4 y) noexcept
+    {
+        const __m128 m = _mm_cmpgt_ps (a.v, b.v);
+        return { _mm_or_ps (_mm_and_ps (m, x.v), _mm_andnot_ps (m, y.v)) };
+    }
+
+    float lane0() const noexcept                            { return _mm_cvtss_f32 (v); }
+    float lane1() const noexcept                            { return _mm_cvtss_f32 (_mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 1, 1, 1))); }
+   #elif LANES_NEON
+    float32x4_t v;
+
+    static Lanes4 load (const float* p) noexcept            { return { vld1q_f32 (p) }; }
+    void store (float* p) const noexcept                    { vst1q_f32 (p, v); }
+    static Lanes4 set (float a, float b) noexcept           { const float t[4] { a, b, 0.0f, 0.0f }; return { vld1q_f32 (t) }; }
+    static Lanes4 set (float a, float b, float c, float d) noexcept { const float t[4] { a, b, c, d }; return { vld1q_f32 (t) }; }
+    static Lanes4 fill (float a) noexcept                   { return { vdupq_n_f32 (a) }; }
+
+    friend Lanes4 operator+ (Lanes4 a, Lanes4 b) noexcept   { return { vaddq_f32 (a.v, b.v) }; }
+    friend Lanes4 operator- (Lanes4 a, Lanes4 b) noexcept   { return { vsubq_f32 (a.v, b.v) }; }
+    friend Lanes4 operator* (Lanes4 a, Lanes4 b) noexcept   { return { vmulq_f32 (a.v, b.v) }; }
+
+    static Lanes4 abs (Lanes4 a) noexcept                   { return { vabsq_f32 (a.v) }; }
+    static Lanes4 sqrt (Lanes4 a) noexcept                  { return { vsqrtq_f32 (a.v) }; }
+    static Lanes4 max (Lanes4 a, Lanes4 b) noexcept         { return { vmaxq_f32 (a.v, b.v) }; } // differs from SSE only for NaN
+    static Lanes4 swapPairs (Lanes4 a) noexcept             { return { vrev64q_f32 (a.v) }; }
+    static Lanes4 broadcast0 (Lanes4 a) noexcept            { return { vdupq_laneq_f32 (a.v, 0) }; }
+
+    static Lanes4 selectGreater (Lanes4 a, Lanes4 b, Lanes4 x, Lanes4 y) noexcept
+    {
+        return { vbslq_f32 (vcgtq_f32 (a.v, b.v), x.v, y.v) };
+    }
+
+    float lane0() const noexcept                            { return vgetq_lane_f32 (v, 0); }
+    float lane1() const noexcept                            { return vgetq_lane_f32 (v, 1); }
+   #else
+    float v[4];
+
+    static Lanes4 load (const float* p) noexcept            { return { { p[0], p[1], p[2], p[3] } }; }
+    void store (float* p) const noexcept                    { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+    static Lanes4 set (float a, float b) noexcept           { return { { a, b, 0.0f, 0.0f } }; }
+    static Lanes4 set (float a, float b, float c, float d) noexcept { return { { a, b, c, d } }; }
+    static Lanes4 fill (float a) noexcept                   { return { { a, a, a, a } }; }
+
+    template <typename Op>
+    static Lanes4 map (Lanes4 a, Lanes4 b, Op op) noexcept  { return { { op (a.v[0], b.v[0]), op (a.v[1], b.v[1]), op (a.v[2], b.v[2]), op (a.v[3], b.v[3]) } }; }
+
+    friend Lanes4 operator+ (Lanes4 a, Lanes4 b) noexcept   { return map (a, b, [] (float p, float q) { return p + q; }); }
+    friend Lanes4 operator- (Lanes4 a, Lanes4 b) noexcept   { return map (a, b, [] (float p, float q) { return p - q; }); }
+    friend Lanes4 operator* (Lanes4 a, Lanes4 b) noexcept   { return map (a, b, [] (float p, float q) { return p * q; }); }
+
+    static Lanes4 abs (Lanes4 a) noexcept                   { return map (a, a, [] (float p, float) { return std::fabs (p); }); }
+    static Lanes4 sqrt (Lanes4 a) noexcept                  { return map (a, a, [] (float p, float) { return std::sqrt (p); }); }
+    static Lanes4 max (Lanes4 a, Lanes4 b) noexcept         { return map (a, b, [] (float p, float q) { return p > q ? p : q; }); }
+    static Lanes4 swapPairs (Lanes4 a) noexcept             { return { { a.v[1], a.v[0], a.v[3], a.v[2] } }; }
+    static Lanes4 broadcast0 (Lanes4 a) noexcept            { return fill (a.v[0]); }
+
+    static Lanes4 selectGreater (Lanes4 a, Lanes4 b, Lanes4 x, Lanes4 y) noexcept
+    {
+        Lanes4 r;
+        for (int i = 0; i < 4; ++i)
+            r.v[i] = a.v[i] > b.v[i] ? x.v[i] : y.v[i];
+        return r;
+    }
+
+    float lane0() const noexcept                            { return v[0]; }
+    float lane1() const noexcept                            { return v[1]; }
+   #endif
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Lookahead building blocks. Both allocate in prepare() only; changing the
+// window / delay afterwards just moves indices, so it's safe on the audio thread.
+
+// Running maximum over the last (window + 1) samples.
+// Monotonic deque stored in a fixed ring: every sample is pushed and popped at most once,
+// so the cost is amortised O(1) per sample whatever the window length.
+struct SlidingWindowMax
+{
+    void prepare (int maxWindowSamples)
+    {
+        capacity = std::max (0, maxWindowSamples) + 1;
+        values.assign ((size_t) capacity, 0.0f);
+        stamps.assign ((size_t) capacity, 0);
+        window = std::min (window, capacity - 1);
+        reset();
+    }
+
+    void reset()
+    {
+        front = 0;
+        count = 0;
+        now = 0;
+    }
+
+    void setWindow (int windowSamples)
+    {
+        window = std::max (0, std::min (windowSamples, capacity - 1));
+    }
+
+    float processSample (float x)
+    {
+        // drop everything the new sample dominates
+        while (count > 0 && values[(size_t) back()] <= x)
+            --count;
+
+        const int slot = (front + count) % capacity;
+        values[(size_t) slot] = x;
+        stamps[(size_t) slot] = now;
+        ++count;
+
+        // drop whatever fell out of the window (the new sample is always inside it)
+        while (stamps[(size_t) front] + (uint64_t) window < now)
+        {
+            front = (front + 1) % capacity;
+            --count;
+        }
+
+        ++now;
+        return values[(size_t) front];
+    }
+
+    int back() const { return (front + count - 1) % capacity; }
+
+    std::vector<float> values;
+    std::vector<uint64_t> stamps;
+    int capacity = 1;
+    int window = 0;
+    int front = 0, count = 0;
+    uint64_t now = 0;
+};
+
+// Plain ring buffer delay, 0..maxDelaySamples. Holds audio, so it comes in float and double.
+template <typename Sample = float>
+struct LookaheadDelay
+{
+    void prepare (int maxDelaySamples)
+    {
+        size = std::max (0, maxDelaySamples) + 1;
+        buffer.assign ((size_t) size, Sample (0));
+        delay = std::min (delay, size - 1);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill (buffer.begin(), buffer.end(), Sample (0));
+        writePos = 0;
+    }
+
+    void setDelay (int delaySamples)
+    {
+        delay = std::max (0, std::min (delaySamples, size - 1));
+    }
+
+    Sample processSample (Sample x)
+    {
+        buffer[(size_t) writePos] = x;
+        int readPos = writePos - delay;
+        if (readPos < 0) readPos += size;
+        writePos = (writePos + 1 == size) ? 0 : writePos + 1;
+        return buffer[(size_t) readPos];
+    }
+
+    std::vector<Sample> buffer;
+    int size = 1;
+    int delay = 0;
+    int writePos = 0;
+};
@@ -0,0 +1,252 @@
+#include "Loudness.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // BS.1770: L = -0.691 + 10 log10 (sum of G_i * mean square)
+    float loudnessOf (double meanSquare) noexcept
+    {
+        return meanSquare > 0.0 ? std::max (LoudnessMeter::minLufs, (float) (-0.691 + 10.0 * std::log10 (meanSquare)))
+                                : LoudnessMeter::minLufs;
+    }
+}
+
+//==============================================================================
+// K-weighting coefficients for any rate: the two BS.1770 stages (specified at 48 kHz) as analogue
+// prototypes through the bilinear transform, so 48 kHz gives the published coefficients back.
+void LoudnessMeter::prepare (double sampleRate, int channels, const float* channelWeights)
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    {
+        const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+        const double k = std::tan (pi * f0 / sampleRate);
+        const double vh = std::pow (10.0, gainDb / 20.0);
+        const double vb = std::pow (vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        const double k = std::tan (pi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    numChannels = std::max (0, channels);
+    weights.assign (channelWeights, channelWeights + numChannels);
+    filterState.assign ((size_t) (4 * numChannels), 0.0);
+    stepSamples = std::max (1, (int) std::lround (sampleRate * 0.1));
+
+    binEnergy.assign (numBins, 0.0);
+    binCount.assign (numBins, 0);
+
+    reset();
+}
+
+void LoudnessMeter::reset()
+{
+    std::fill (filterState.begin(), filterState.end(), 0.0);
+    stepPos = 0;
+    stepEnergy = 0.0;
+    std::fill (std::begin (stepMeanSquare), std::end (stepMeanSquare), 0.0);
+    lastStep = stepsPerShortTerm - 1;
+    numSteps = 0;
+
+    momentaryLufs = shortTermLufs = minLufs;
+    resetIntegrated();
+}
+
+void LoudnessMeter::resetIntegrated()
+{
+    maxMomentaryLufs = maxShortTermLufs = minLufs;
+    std::fill (binEnergy.begin(), binEnergy.end(), 0.0);
+    std::fill (binCount.begin(), binCount.end(), 0u);
+}
+
+void LoudnessMeter::process (const float* const* channels, int numSamples)
+{
+    for (int start = 0; start < numSamples;)
+    {
+        const int num = std::min (numSamples - start, stepSamples - stepPos);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            if (weights[(size_t) ch] == 0.0f)
+                continue;
+
+            double* z = filterState.data() + 4 * ch;
+            double s1 = z[0], s2 = z[1], h1 = z[2], h2 = z[3];
+            double sum = 0.0;
+            const float* x = channels[ch] + start;
+
+            for (int n = 0; n < num; ++n)
+            {
+                const double in = x[n];
+                const double y = shelf.b0 * in + s1;
+                s1 = shelf.b1 * in - shelf.a1 * y + s2;
+                s2 = shelf.b2 * in - shelf.a2 * y;
+
+                const double k = highPass.b0 * y + h1;
+                h1 = highPass.b1 * y - highPass.a1 * k + h2;
+                h2 = highPass.b2 * y - highPass.a2 * k;
+
+                sum += k * k;
+            }
+
+            z[0] = s1; z[1] = s2; z[2] = h1; z[3] = h2;
+            stepEnergy += weights[(size_t) ch] * sum;
+        }
+
+        start += num;
+        stepPos += num;
+        if (stepPos == stepSamples)
+            finishStep();
+    }
+}
+
+// A 100 ms step is complete: move the windows on, and every 400 ms block from here on is a gating block
+void LoudnessMeter::finishStep()
+{
+    lastStep = (lastStep + 1) % stepsPerShortTerm;
+    stepMeanSquare[lastStep] = stepEnergy / stepSamples;
+    stepEnergy = 0.0;
+    stepPos = 0;
+    numSteps = std::min (numSteps + 1, stepsPerShortTerm);
+
+    auto windowMean = [this] (int steps)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < steps; ++i)
+            sum += stepMeanSquare[(lastStep - i + stepsPerShortTerm) % stepsPerShortTerm];
+        return sum / steps;
+    };
+
+    // before a window has filled it reads as the audio so far padded with silence
+    const double momentary = windowMean (stepsPerMomentary);
+    momentaryLufs = loudnessOf (momentary);
+    shortTermLufs = loudnessOf (windowMean (stepsPerShortTerm));
+
+    if (numSteps >= stepsPerMomentary)
+    {
+        maxMomentaryLufs = std::max (maxMomentaryLufs, momentaryLufs);
+
+        if (momentaryLufs > absoluteGateLufs)
+        {
+            const int bin = std::min (numBins - 1, (int) ((momentaryLufs - absoluteGateLufs) * binsPerLu));
+            binEnergy[(size_t) bin] += momentary;
+            ++binCount[(size_t) bin];
+        }
+    }
+
+    if (numSteps >= stepsPerShortTerm)
+        maxShortTermLufs = std::max (maxShortTermLufs, shortTermLufs);
+}
+
+float LoudnessMeter::getIntegratedLufs() const noexcept
+{
+    double energy = 0.0;
+    uint64_t count = 0;
+    for (int b = 0; b < numBins; ++b)
+    {
+        energy += binEnergy[(size_t) b];
+        count += binCount[(size_t) b];
+    }
+
+    if (count == 0)
+        return minLufs;
+
+    // relative gate: 10 LU under the loudness of everything above the absolute gate
+    const float gate = loudnessOf (energy / (double) count) - 10.0f;
+    const int gateBin = std::max (0, (int) std::floor ((gate - absoluteGateLufs) * binsPerLu));
+
+    energy = 0.0;
+    count = 0;
+    for (int b = gateBin; b < numBins; ++b)
+    {
+        if (binCount[(size_t) b] == 0)
+            continue;
+        if (b == gateBin && loudnessOf (binEnergy[(size_t) b] / binCount[(size_t) b]) <= gate)
+            continue;
+
+        energy += binEnergy[(size_t) b];
+        count += binCount[(size_t) b];
+    }
+
+    return count > 0 ? loudnessOf (energy / (double) count) : minLufs;
+}
+
+//==============================================================================
+// BS.1770-4 annex 2: 48 taps, 4 phases of 12 (phase 3 mirrors phase 0, phase 2 mirrors phase 1)
+const float TruePeakMeter::coefficients[numPhases][tapsPerPhase] = {
+    {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+       0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+       0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+       0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+       0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+void TruePeakMeter::prepare (int channels)
+{
+    numChannels = std::max (0, channels);
+    history.assign ((size_t) (2 * tapsPerPhase * numChannels), 0.0f);
+    reset();
+}
+
+void TruePeakMeter::reset()
+{
+    std::fill (history.begin(), history.end(), 0.0f);
+    historyPos = 0;
+    peak = 0.0f;
+}
+
+void TruePeakMeter::process (const float* const* channels, int numSamples)
+{
+    float blockPeak = peak;
+    int pos = historyPos;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        float* h = history.data() + 2 * tapsPerPhase * ch;
+        const float* x = channels[ch];
+        pos = historyPos;
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            // newest sample at h[pos], written twice so h[pos .. pos + 11] is always newest -> oldest
+            pos = (pos == 0 ? tapsPerPhase : pos) - 1;
+            h[pos] = h[pos + tapsPerPhase] = x[n];
+
+            for (int phase = 0; phase < numPhases; ++phase)
+            {
+                float y = 0.0f;
+                for (int t = 0; t < tapsPerPhase; ++t)
+                    y += coefficients[phase][t] * h[pos + t];
+                blockPeak = std::max (blockPeak, std::fabs (y));
+            }
+        }
+    }
+
+    historyPos = pos;
+    peak = blockPeak;
+}
+
+float TruePeakMeter::getTruePeakDb() const noexcept
+{
+    return peak > 1.0e-5f ? 20.0f * std::log10 (peak) : -100.0f;
+}
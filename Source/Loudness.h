@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// ITU-R BS.1770-4 loudness and true peak.
+//
+// Meant for an analysis thread, not the audio thread: prepare() allocates and the K-weighting /
+// interpolation cost is a few hundred ns per sample frame. Feed blocks of any size to process();
+// readings are available after every call.
+
+// K-weighted loudness: momentary (400 ms), short-term (3 s) and gated integrated, in LUFS.
+class LoudnessMeter
+{
+public:
+    static constexpr float minLufs = -100.0f; // a reading with nothing (or only silence) to go on
+
+    // channelWeights[ch] is the BS.1770 G_i: 1 for front / centre / height, 1.41 for the side
+    // surrounds, 0 to leave a channel out (LFE)
+    void prepare (double sampleRate, int numChannels, const float* channelWeights);
+
+    void reset();           // everything, as after prepare()
+    void resetIntegrated(); // gating history and the maxima; the momentary and short-term windows carry on
+
+    void process (const float* const* channels, int numSamples);
+
+    float getMomentaryLufs() const noexcept    { return momentaryLufs; }
+    float getShortTermLufs() const noexcept    { return shortTermLufs; }
+    float getMaxMomentaryLufs() const noexcept { return maxMomentaryLufs; }
+    float getMaxShortTermLufs() const noexcept { return maxShortTermLufs; }
+    float getIntegratedLufs() const noexcept;
+
+private:
+    // Direct form II transposed in double: the 38 Hz RLB high-pass has its poles right next to 1
+    struct Biquad { double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0; };
+
+    void finishStep();
+
+    Biquad shelf, highPass; // the K-weighting pre-filter and RLB stages
+    int numChannels = 0;
+    std::vector<double> filterState; // 4 per channel: shelf z1, z2, high-pass z1, z2
+    std::vector<float> weights;
+
+    // The windows move in 100 ms steps (the 75 % overlap of the 400 ms gating blocks)
+    static constexpr int stepsPerMomentary = 4, stepsPerShortTerm = 30;
+    int stepSamples = 4800;
+    int stepPos = 0;
+    double stepEnergy = 0.0;                     // weighted sum of squares so far in this step
+    double stepMeanSquare[stepsPerShortTerm] {}; // ring, newest at lastStep
+    int lastStep = stepsPerShortTerm - 1;
+    int numSteps = 0;                            // since reset(), saturating
+
+    float momentaryLufs = minLufs, shortTermLufs = minLufs;
+    float maxMomentaryLufs = minLufs, maxShortTermLufs = minLufs;
+
+    // Gating blocks that passed the absolute gate (-70 LUFS), by loudness in 0.01 LU bins up to +10 LUFS.
+    // Per bin the block count and the sum of their mean squares, so the integrated value is exact except
+    // for the one bin the relative gate falls in, which counts if its own mean is above the gate.
+    static constexpr float absoluteGateLufs = -70.0f, binsPerLu = 100.0f;
+    static constexpr int numBins = 8000;
+    std::vector<double> binEnergy;
+    std::vector<uint32_t> binCount;
+};
+
+// Max of the 4x oversampled signal (the BS.1770-4 annex 2 interpolator) over every channel since reset.
+class TruePeakMeter
+{
+public:
+    void prepare (int numChannels);
+    void reset();
+
+    void process (const float* const* channels, int numSamples);
+
+    float getTruePeak() const noexcept { return peak; } // linear
+    float getTruePeakDb() const noexcept;                // dBTP, floored at -100
+
+private:
+    static constexpr int numPhases = 4, tapsPerPhase = 12;
+    static const float coefficients[numPhases][tapsPerPhase];
+
+    int numChannels = 0;
+    std::vector<float> history; // per channel the last tapsPerPhase inputs, stored twice so a window is contiguous
+    int historyPos = 0;
+    float peak = 0.0f;
+};
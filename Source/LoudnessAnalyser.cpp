@@ -0,0 +1,139 @@
+#include "LoudnessAnalyser.h"
+
+LoudnessAnalyser::LoudnessAnalyser() : juce::Thread ("Loudness analysis") {}
+
+LoudnessAnalyser::~LoudnessAnalyser()
+{
+    stopThread (1000);
+}
+
+void LoudnessAnalyser::prepare (double sampleRate, int numChannels, const float* channelWeights, int maxBlockSize)
+{
+    stopThread (1000);
+
+    {
+        const std::lock_guard<std::mutex> lock (consumerLock);
+
+        // a second of audio, and always room for a few of the largest blocks
+        const int capacity = juce::jmax ((int) sampleRate, 4 * maxBlockSize);
+
+        for (int s = 0; s < numStreams; ++s)
+        {
+            rings[s].allocate (numChannels, capacity);
+            loudness[s].prepare (sampleRate, numChannels, channelWeights);
+            truePeak[s].prepare (numChannels);
+            analysedSamples[s] = 0;
+        }
+
+        popBuffer.setSize (numChannels, maxFramesPerPop);
+        resetPending.store (false);
+    }
+
+    {
+        const std::lock_guard<std::mutex> lock (readingLock);
+        for (auto& r : readings)
+            r = {};
+    }
+
+    if (enabled.load())
+        startThread (juce::Thread::Priority::low);
+}
+
+void LoudnessAnalyser::release()
+{
+    stopThread (1000);
+
+    const std::lock_guard<std::mutex> lock (consumerLock);
+    for (auto& ring : rings)
+        ring.allocate (0, 0);
+}
+
+void LoudnessAnalyser::setEnabled (bool shouldAnalyse)
+{
+    enabled.store (shouldAnalyse);
+
+    if (! shouldAnalyse)
+    {
+        stopThread (1000);
+        return;
+    }
+
+    bool prepared;
+    {
+        const std::lock_guard<std::mutex> lock (consumerLock);
+        prepared = rings[0].getNumChannels() > 0;
+    }
+
+    if (prepared && ! isThreadRunning())
+        startThread (juce::Thread::Priority::low);
+}
+
+LoudnessAnalyser::Reading LoudnessAnalyser::getReading (Stream stream) const
+{
+    const std::lock_guard<std::mutex> lock (readingLock);
+    return readings[stream];
+}
+
+void LoudnessAnalyser::flush()
+{
+    const std::lock_guard<std::mutex> lock (consumerLock);
+    analysePending();
+}
+
+void LoudnessAnalyser::run()
+{
+    while (! threadShouldExit())
+    {
+        {
+            const std::lock_guard<std::mutex> lock (consumerLock);
+            analysePending();
+        }
+        wait (passIntervalMs);
+    }
+}
+
+void LoudnessAnalyser::analysePending()
+{
+    if (resetPending.exchange (false))
+    {
+        for (int s = 0; s < numStreams; ++s)
+        {
+            loudness[s].resetIntegrated();
+            truePeak[s].reset();
+            analysedSamples[s] = 0;
+        }
+    }
+
+    Reading fresh[numStreams];
+
+    for (int s = 0; s < numStreams; ++s)
+    {
+        auto& ring = rings[s];
+        if (ring.getNumChannels() == 0)
+            continue;
+
+        for (;;)
+        {
+            const int num = ring.pop (popBuffer.getArrayOfWritePointers(), maxFramesPerPop);
+            if (num == 0)
+                break;
+
+            loudness[s].process (popBuffer.getArrayOfReadPointers(), num);
+            truePeak[s].process (popBuffer.getArrayOfReadPointers(), num);
+            analysedSamples[s] += (juce::uint64) num;
+        }
+
+        auto& r = fresh[s];
+        r.momentaryLufs    = loudness[s].getMomentaryLufs();
+        r.shortTermLufs    = loudness[s].getShortTermLufs();
+        r.integratedLufs   = loudness[s].getIntegratedLufs();
+        r.maxMomentaryLufs = loudness[s].getMaxMomentaryLufs();
+        r.maxShortTermLufs = loudness[s].getMaxShortTermLufs();
+        r.truePeakDb       = truePeak[s].getTruePeakDb();
+        r.analysedSamples  = analysedSamples[s];
+        r.droppedSamples   = ring.getNumDroppedFrames();
+    }
+
+    const std::lock_guard<std::mutex> lock (readingLock);
+    std::copy (std::begin (fresh), std::end (fresh), std::begin (readings));
+}
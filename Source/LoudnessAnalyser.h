@@ -0,0 +1,87 @@
+#pragma once
+#include <JuceHeader.h>
+#include <mutex>
+
+#include "Loudness.h"
+#include "Telemetry.h"
+
+// BS.1770 loudness and true peak of the processor's input and output, computed off the audio thread.
+//
+// The audio thread only copies each block into a capture ring (one per stream); a worker thread drains
+// the rings every few milliseconds, runs the meters and publishes a Reading. If the worker falls behind,
+// blocks that don't fit are dropped (Reading::droppedSamples says how many) - the audio thread never
+// waits and never takes a lock. Readings are for the editor and the command line tools.
+//
+// Off until someone asks for readings (setEnabled): the editor while it's open, the batch renderer for
+// its whole run. While off, capture() is a single relaxed load and no worker thread exists, so idle
+// instances in a large session cost nothing here.
+class LoudnessAnalyser : private juce::Thread
+{
+public:
+    enum Stream { input = 0, output = 1, numStreams = 2 };
+
+    struct Reading
+    {
+        float momentaryLufs = LoudnessMeter::minLufs;
+        float shortTermLufs = LoudnessMeter::minLufs;
+        float integratedLufs = LoudnessMeter::minLufs;
+        float maxMomentaryLufs = LoudnessMeter::minLufs;
+        float maxShortTermLufs = LoudnessMeter::minLufs;
+        float truePeakDb = -100.0f;       // max since the last reset, dBTP
+        juce::uint64 analysedSamples = 0; // since the last reset
+        juce::uint64 droppedSamples = 0;  // captured blocks the worker had no room for, since prepare()
+    };
+
+    LoudnessAnalyser();
+    ~LoudnessAnalyser() override;
+
+    // Not while the audio thread is capturing (prepareToPlay): stops the worker, sizes the rings for
+    // about a second of audio, clears every reading and starts the worker again if analysis is enabled.
+    // channelWeights: the BS.1770 G_i per channel (see LoudnessMeter::prepare).
+    void prepare (double sampleRate, int numChannels, const float* channelWeights, int maxBlockSize);
+    void release(); // stops the worker and frees the rings
+
+    // Message thread (or the tool's own thread). Enabling starts the worker if prepare() has run, and
+    // it's started by prepare() from then on; disabling stops it. Readings carry on where they were.
+    void setEnabled (bool shouldAnalyse);
+    bool isEnabled() const noexcept { return enabled.load (std::memory_order_relaxed); }
+
+    // Audio thread: copies numChannels pointers' worth of numSamples into the stream's ring, or drops the block
+    template <typename Sample>
+    void capture (Stream stream, const Sample* const* channels, int numSamples) noexcept
+    {
+        if (enabled.load (std::memory_order_relaxed))
+            rings[stream].push (channels, numSamples);
+    }
+
+    // Any thread but the audio thread
+    Reading getReading (Stream) const;
+    void reset() noexcept { resetPending.store (true); } // integrated, maxima and true peak start again on the next pass
+
+    // Analyses everything captured so far on the calling thread, e.g. after each block of an offline render
+    // so nothing is dropped however fast the blocks come
+    void flush();
+
+private:
+    void run() override;
+    void analysePending(); // under consumerLock
+
+    static constexpr int passIntervalMs = 10;
+    static constexpr int maxFramesPerPop = 4096;
+
+    AudioCaptureRing rings[numStreams];
+    LoudnessMeter loudness[numStreams];
+    TruePeakMeter truePeak[numStreams];
+    juce::uint64 analysedSamples[numStreams] {};
+
+    std::mutex consumerLock;            // the worker and flush() take turns at the rings and meters
+    juce::AudioBuffer<float> popBuffer; // consumer side scratch
+
+    mutable std::mutex readingLock;
+    Reading readings[numStreams];
+
+    std::atomic<bool> resetPending { false };
+    std::atomic<bool> enabled { false };
+
+    JUCE_DECLARE_NON_COPYABLE (LoudnessAnalyser)
+};
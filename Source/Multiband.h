@@ -0,0 +1,460 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Followers.h"
+#include "GainComputer.h"
+#include "Lookahead.h"
+
+// 3- or 4-band version of the compressor.
+//
+// Bands come from Linkwitz-Riley (LR4) crossovers in a tree, with allpass compensation on the
+// other branch so the bands always sum back to a flat (allpass) response.
+// Each band has its own threshold / ratio / knee / attack / release. Per channel the four band
+// followers are one 4-lane SoA step (like DetectorBank across channels), so 4 bands cost about
+// what 1 does; the gain curves then run block-wise through GainComputer.
+// All buffers are allocated in allocate(); everything else is safe on the audio thread.
+
+// One LR4 split point for one channel: two cascaded Butterworth TPT SVFs.
+// Low + high = the 2nd-order Butterworth allpass, so the split itself is flat.
+struct LR4Section
+{
+    void setCutoff (double sampleRate, float hz)
+    {
+        hz = std::min ((float) (0.49 * sampleRate), std::max (10.0f, hz));
+        g = (float) std::tan (3.14159265358979323846 * hz / sampleRate);
+        h = 1.0f / (1.0f + R2 * g + g * g);
+    }
+
+    void reset() { s1 = s2 = s3 = s4 = 0.0f; }
+
+    bool isSettled (float level) const noexcept
+    {
+        return std::fabs (s1) < level && std::fabs (s2) < level && std::fabs (s3) < level && std::fabs (s4) < level;
+    }
+
+    void split (float x, float& low, float& high)
+    {
+        const float yH = (x - (R2 + g) * s1 - s2) * h;
+        const float yB = g * yH + s1;
+        s1 = g * yH + yB;
+        const float yL = g * yB + s2;
+        s2 = g * yB + yL;
+
+        const float yH2 = (yL - (R2 + g) * s3 - s4) * h;
+        const float yB2 = g * yH2 + s3;
+        s3 = g * yH2 + yB2;
+        const float yL2 = g * yB2 + s4;
+        s4 = g * yB2 + yL2;
+
+        low  = yL2;
+        high = yL - R2 * yB + yH - yL2;
+    }
+
+    // same phase as split() at this frequency, flat magnitude: used to line up the other branch
+    float allpass (float x)
+    {
+        const float yH = (x - (R2 + g) * s1 - s2) * h;
+        const float yB = g * yH + s1;
+        s1 = g * yH + yB;
+        const float yL = g * yB + s2;
+        s2 = g * yB + yL;
+        return yL - R2 * yB + yH;
+    }
+
+    static constexpr float R2 = 1.41421356237f;
+    float g = 0.0f, h = 1.0f;
+    float s1 = 0.0f, s2 = 0.0f, s3 = 0.0f, s4 = 0.0f;
+};
+
+// Per-channel band split. 4 bands: f2 first, then f1 / f3 with the opposite allpass on each side.
+// 3 bands: f2 first, then f1 on the low side and the f1 allpass on the high side.
+struct BandSplitter
+{
+    void setCutoffs (double sampleRate, const float* f)
+    {
+        xo1.setCutoff (sampleRate, f[0]);
+        ap1.setCutoff (sampleRate, f[0]);
+        xo2.setCutoff (sampleRate, f[1]);
+        xo3.setCutoff (sampleRate, f[2]);
+        ap3.setCutoff (sampleRate, f[2]);
+    }
+
+    void reset()
+    {
+        xo1.reset(); xo2.reset(); xo3.reset();
+        ap1.reset(); ap3.reset();
+    }
+
+    bool isSettled (float level) const noexcept
+    {
+        return xo1.isSettled (level) && xo2.isSettled (level) && xo3.isSettled (level)
+            && ap1.isSettled (level) && ap3.isSettled (level);
+    }
+
+    void split (float x, float* bands, int numBands)
+    {
+        float low, high;
+        xo2.split (x, low, high);
+
+        if (numBands == 4)
+        {
+            xo1.split (ap3.allpass (low), bands[0], bands[1]);
+            xo3.split (ap1.allpass (high), bands[2], bands[3]);
+        }
+        else
+        {
+            xo1.split (low, bands[0], bands[1]);
+            bands[2] = ap1.allpass (high);
+            bands[3] = 0.0f;
+        }
+    }
+
+    LR4Section xo1, xo2, xo3, ap1, ap3;
+};
+
+// Peak / RMS followers for the four bands of one channel, one lane per band.
+struct BandFollowers
+{
+    void reset()
+    {
+        std::fill (std::begin (env), std::end (env), 0.0f);
+        std::fill (std::begin (power), std::end (power), 0.0f);
+    }
+
+    bool isSettled (float level) const noexcept
+    {
+        for (int b = 0; b < 4; ++b)
+            if (env[b] >= level || power[b] >= level * level)
+                return false;
+        return true;
+    }
+
+    void process (float* x, bool rms)
+    {
+        if (! rms)
+        {
+            for (int b = 0; b < 4; ++b)
+            {
+                const float a = std::fabs (x[b]);
+                const float coeff = (a > env[b]) ? attackCoeff[b] : releaseCoeff[b];
+                env[b] = a + coeff * (env[b] - a);
+                x[b] = env[b];
+            }
+        }
+        else
+        {
+            for (int b = 0; b < 4; ++b)
+            {
+                const float p = x[b] * x[b];
+                const float coeff = (p > power[b]) ? attackCoeff[b] : releaseCoeff[b];
+                power[b] = p + coeff * (power[b] - p);
+                x[b] = std::sqrt (power[b]);
+            }
+        }
+    }
+
+    alignas (16) float env[4] {};
+    alignas (16) float power[4] {};
+    alignas (16) float attackCoeff[4] {};
+    alignas (16) float releaseCoeff[4] {};
+};
+
+class MultibandCompressor
+{
+public:
+    static constexpr int maxBands = 4;
+    static constexpr int maxChannels = DetectorBank::maxChannels;
+
+    struct Band
+    {
+        float thresholdDb = -18.0f;
+        float ratio = 4.0f;
+        float kneeDb = 6.0f;
+        float attackMs = 10.0f;
+        float releaseMs = 100.0f;
+    };
+
+    struct Settings
+    {
+        bool hpfOn = false;
+        bool rms = false;
+        float unlink = 0.0f, link = 1.0f;
+        float inputGain = 1.0f, makeupGain = 1.0f;
+
+        // Per-sample values while the processor is ramping a parameter (nullptr = the constant above).
+        // Indexed like the block passed to process(); the gains come as a pair.
+        const float* inputGainRamp = nullptr;
+        const float* makeupGainRamp = nullptr;
+        const float* unlinkRamp = nullptr;
+
+        const int* linkGroup = nullptr; // per channel, see the processor's updateLinkGroups
+        int numLinkGroups = 1;
+
+        // External key: per-channel host-rate pointers, read in place (nullptr = key from the input).
+        // Sample n of the (oversampled) block reads key[ch][n >> keyShift].
+        const float* const* key = nullptr;
+        int keyShift = 0;
+    };
+
+    // Allocation happens here only. maxBlock is in samples at the highest processing rate.
+    void allocate (int channels, int maxBlock, int maxLookaheadSamples)
+    {
+        numChannels = std::min (maxChannels, std::max (1, channels));
+        blockCapacity = std::max (1, maxBlock);
+
+        const size_t planes = (size_t) (maxBands * numChannels);
+        bandDet.assign (planes * (size_t) blockCapacity, 0.0f);
+        bandAudio.assign (planes * (size_t) blockCapacity, 0.0f);
+
+        bandLookahead.resize (planes);
+        for (auto& w : bandLookahead)
+            w.prepare (maxLookaheadSamples);
+        for (int ch = 0; ch < numChannels; ++ch)
+            delay[ch].prepare (maxLookaheadSamples);
+    }
+
+    // Rate change (prepareToPlay / oversampling switch): recompute everything, clear state.
+    void setSampleRate (double rate)
+    {
+        sampleRate = rate;
+        for (int b = 0; b < maxBands; ++b)
+            updateBandCoefficients (b);
+        updateCrossovers();
+        for (int ch = 0; ch < maxChannels; ++ch)
+        {
+            hpf[ch].sr = rate;
+            hpf[ch].setCutoff (hpfCutoff);
+        }
+        reset();
+    }
+
+    void reset()
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            audioSplit[ch].reset();
+            detSplit[ch].reset();
+            followers[ch].reset();
+            hpf[ch].reset();
+            delay[ch].reset();
+        }
+        for (auto& w : bandLookahead)
+            w.reset();
+    }
+
+    // Same idea as DetectorBank::isSettled: crossovers, key HPF and band followers all below level.
+    // The lookahead delay isn't checked; the processor waits for it to flush before going idle.
+    bool isSettled (float level) const noexcept
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            if (! audioSplit[ch].isSettled (level) || ! detSplit[ch].isSettled (level) || ! followers[ch].isSettled (level)
+                || std::fabs (hpf[ch].x1) >= level || std::fabs (hpf[ch].y1) >= level)
+                return false;
+        }
+        return true;
+    }
+
+    void setNumBands (int n)
+    {
+        n = n >= 4 ? 4 : 3;
+        if (n != numBands)
+        {
+            numBands = n;
+            reset(); // different tree, old filter state doesn't apply
+        }
+    }
+
+    int getNumBands() const noexcept { return numBands; }
+
+    void setCrossovers (float f1, float f2, float f3)
+    {
+        float f[3] = { f1, f2, f3 };
+        std::sort (f, f + 3); // keep the tree ordered whatever the knobs say
+        if (std::equal (f, f + 3, crossover))
+            return;
+        std::copy (f, f + 3, crossover);
+        updateCrossovers();
+    }
+
+    void setBand (int b, const Band& p)
+    {
+        auto& cur = bands[b];
+        const bool curveChanged = p.thresholdDb != cur.thresholdDb || p.ratio != cur.ratio || p.kneeDb != cur.kneeDb;
+        const bool timeChanged  = p.attackMs != cur.attackMs || p.releaseMs != cur.releaseMs;
+        cur = p;
+
+        if (curveChanged)
+            curves[b].setParameters (p.thresholdDb, p.ratio, p.kneeDb);
+        if (timeChanged)
+            updateBandCoefficients (b);
+    }
+
+    void setHpfCutoff (float hz)
+    {
+        if (hz == hpfCutoff) return;
+        hpfCutoff = hz;
+        for (int ch = 0; ch < maxChannels; ++ch)
+            hpf[ch].setCutoff (hz);
+    }
+
+    void setLookahead (int samples)
+    {
+        if (lookaheadSamples == 0 && samples > 0)
+        {
+            for (auto& w : bandLookahead) w.reset();
+            for (int ch = 0; ch < numChannels; ++ch) delay[ch].reset();
+        }
+
+        lookaheadSamples = samples;
+        for (auto& w : bandLookahead) w.setWindow (samples);
+        for (int ch = 0; ch < numChannels; ++ch) delay[ch].setDelay (samples);
+    }
+
+    // x: numChannels channel pointers, processed in place. For the meters, minGain[ch] is lowered to
+    // the lowest band gain seen and maxDetector[ch] raised to the loudest band detector level.
+    void process (float* const* x, int numSamples, const Settings& s, float* minGain, float* maxDetector)
+    {
+        // The detector can share the audio split unless the key, the HPF or the lookahead delay makes them differ
+        const bool separateDetector = s.key != nullptr || s.hpfOn || lookaheadSamples > 0;
+
+        for (int start = 0; start < numSamples; start += blockCapacity)
+        {
+            const int num = std::min (blockCapacity, numSamples - start);
+
+            // 1) split + band followers, per channel
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                float* in = x[ch] + start;
+                const float* key = s.key != nullptr ? s.key[ch] : nullptr;
+                alignas (16) float band[4];
+
+                for (int n = 0; n < num; ++n)
+                {
+                    const float xin = in[n] * (s.inputGainRamp != nullptr ? s.inputGainRamp[start + n] : s.inputGain);
+                    const float audioIn = lookaheadSamples > 0 ? delay[ch].processSample (xin) : xin;
+
+                    audioSplit[ch].split (audioIn, band, numBands);
+                    for (int b = 0; b < numBands; ++b)
+                        audioPlane (b, ch)[n] = band[b];
+
+                    if (separateDetector)
+                    {
+                        const float keyIn = key != nullptr ? key[(start + n) >> s.keyShift] : xin;
+                        detSplit[ch].split (s.hpfOn ? hpf[ch].processSample (keyIn) : keyIn, band, numBands);
+                    }
+
+                    followers[ch].process (band, s.rms);
+                    for (int b = 0; b < numBands; ++b)
+                        detPlane (b, ch)[n] = band[b];
+                }
+            }
+
+            // 2) link per band across channels, 3) lookahead, 4) curve, 5) sum
+            for (int b = 0; b < numBands; ++b)
+            {
+                if (numChannels > 1 && (s.link > 0.0f || s.unlinkRamp != nullptr))
+                {
+                    float groupMax[maxChannels + 2];
+                    for (int n = 0; n < num; ++n)
+                    {
+                        std::fill (groupMax, groupMax + s.numLinkGroups, 0.0f);
+                        for (int ch = 0; ch < numChannels; ++ch)
+                            groupMax[s.linkGroup[ch]] = std::max (groupMax[s.linkGroup[ch]], detPlane (b, ch)[n]);
+
+                        const float unlink = s.unlinkRamp != nullptr ? s.unlinkRamp[start + n] : s.unlink;
+                        const float link   = s.unlinkRamp != nullptr ? 1.0f - unlink : s.link;
+                        for (int ch = 0; ch < numChannels; ++ch)
+                            detPlane (b, ch)[n] = detPlane (b, ch)[n] * unlink + groupMax[s.linkGroup[ch]] * link;
+                    }
+                }
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    float* d = detPlane (b, ch);
+
+                    if (lookaheadSamples > 0)
+                    {
+                        auto& w = bandLookahead[(size_t) (b * numChannels + ch)];
+                        for (int n = 0; n < num; ++n)
+                            d[n] = w.processSample (d[n]);
+                    }
+
+                    if (num > 0)
+                        maxDetector[ch] = std::max (maxDetector[ch], *std::max_element (d, d + num));
+                    curves[b].process (d, d, num);
+                }
+            }
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                float* out = x[ch] + start;
+                float lowest = minGain[ch];
+
+                for (int n = 0; n < num; ++n)
+                {
+                    float sum = 0.0f;
+                    for (int b = 0; b < numBands; ++b)
+                    {
+                        const float gain = detPlane (b, ch)[n];
+                        lowest = std::min (lowest, gain);
+                        sum += audioPlane (b, ch)[n] * gain;
+                    }
+                    out[n] = sum * (s.makeupGainRamp != nullptr ? s.makeupGainRamp[start + n] : s.makeupGain);
+                }
+
+                minGain[ch] = lowest;
+            }
+        }
+    }
+
+private:
+    float* detPlane (int b, int ch)   { return bandDet.data()   + (size_t) ((b * numChannels + ch) * blockCapacity); }
+    float* audioPlane (int b, int ch) { return bandAudio.data() + (size_t) ((b * numChannels + ch) * blockCapacity); }
+
+    void updateCrossovers()
+    {
+        for (int ch = 0; ch < maxChannels; ++ch)
+        {
+            audioSplit[ch].setCutoffs (sampleRate, crossover);
+            detSplit[ch].setCutoffs (sampleRate, crossover);
+        }
+    }
+
+    void updateBandCoefficients (int b)
+    {
+        EnvelopeFollower<float> f; // same time-constant formula as the broadband followers
+        f.sr = sampleRate;
+        f.updateTimeConstants (bands[b].attackMs, bands[b].releaseMs);
+
+        for (int ch = 0; ch < maxChannels; ++ch)
+        {
+            followers[ch].attackCoeff[b] = f.attackCoeff;
+            followers[ch].releaseCoeff[b] = f.releaseCoeff;
+        }
+    }
+
+    double sampleRate = 44100.0;
+    int numChannels = 2;
+    int numBands = 3;
+    int blockCapacity = 1;
+    int lookaheadSamples = 0;
+
+    float crossover[3] = { 120.0f, 1000.0f, 5000.0f };
+    Band bands[maxBands];
+    GainComputer curves[maxBands];
+
+    float hpfCutoff = 80.0f;
+
+    BandSplitter audioSplit[maxChannels];
+    BandSplitter detSplit[maxChannels];
+    BandFollowers followers[maxChannels];
+    OnePoleHPF<float> hpf[maxChannels];
+    LookaheadDelay<float> delay[maxChannels];
+
+    std::vector<SlidingWindowMax> bandLookahead; // [band][channel]
+    std::vector<float> bandDet;                  // [band][channel][sample]: detector level, then gain
+    std::vector<float> bandAudio;                // [band][channel][sample]
+};
@@ -1,9 +1,16 @@
 #include "PluginEditor.h"
 #include "PluginProcessor.h"
 
+namespace
+{
+    constexpr float meterMaxDb = 24.0f; // bottom of the meters and the trace
+}
+
 StereoCompressorBuild1AudioProcessorEditor::StereoCompressorBuild1AudioProcessorEditor (StereoCompressorBuild1AudioProcessor& p)
     : AudioProcessorEditor (&p), processor (p)
 {
+    setOpaque (true); // we fill every pixel, so partial repaints never have to go through the host window
+
     detectorModeBox.addItem ("Peak", 1);
     detectorModeBox.addItem ("RMS",  2);
     addAndMakeVisible (detectorModeBox);
@@ -11,109 +18,412 @@ StereoCompressorBuild1AudioProcessorEditor::StereoCompressorBuild1AudioProcessor
     detectorModeAttach = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
         processor.apvts, "detectorMode", detectorModeBox);
 
+    for (int slot = 0; slot < 2; ++slot)
+    {
+        auto& button = presetButtons[slot];
+        button.setButtonText (slot == 0 ? "A" : "B");
+        button.setColour (juce::TextButton::buttonOnColourId, juce::Colours::orange);
+        button.setToggleState (processor.getActivePresetSlot() == slot, juce::dontSendNotification);
+        button.onClick = [this, slot] { processor.selectPresetSlot (slot); };
+        addAndMakeVisible (button);
+    }
+
+    loudnessResetButton.setButtonText ("Reset LU");
+    loudnessResetButton.onClick = [this] { processor.getLoudnessAnalyser().reset(); };
+    addAndMakeVisible (loudnessResetButton);
+
     genericEditor = std::make_unique<juce::GenericAudioProcessorEditor> (processor);
     addAndMakeVisible (genericEditor.get());   
 
+    processor.getLoudnessAnalyser().setEnabled (true); // only analysed while someone's looking
+    processor.discardMeterFrames(); // whatever piled up while no editor was open
+    statsWindowStart = juce::Time::getMillisecondCounterHiRes();
     startTimerHz (30);
     setSize (900, 700);
 }
+
 void StereoCompressorBuild1AudioProcessorEditor::paint (juce::Graphics& g)
 {
-    g.fillAll (juce::Colours::black);
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
 
-    const float grL = juce::jmax (0.0f, processor.getLastGainReductionL());
-    const float grR = juce::jmax (0.0f, processor.getLastGainReductionR());
+    // Static layer: rebuilt after a resize or when the window moves to a screen with another scale
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    if (staticLayer.isNull() || scale != staticLayerScale)
+    {
+        staticLayerScale = scale;
+        staticLayer = juce::Image (juce::Image::RGB,
+                                   juce::jmax (1, juce::roundToInt ((float) getWidth() * scale)),
+                                   juce::jmax (1, juce::roundToInt ((float) getHeight() * scale)), true);
+        juce::Graphics layer (staticLayer);
+        layer.addTransform (juce::AffineTransform::scale (scale));
+        drawStaticLayer (layer);
+    }
 
-    // Recreate the same layout as resized()
-    auto r = getLocalBounds().reduced (10);
+    g.drawImageTransformed (staticLayer, juce::AffineTransform::scale (1.0f / scale)); // clipped to the dirty region
 
-    auto topRow = r.removeFromTop (30);
-    // (detectorModeBox lives in topRow in resized(); we don’t draw it here)
+    // Moving parts, each only if it's inside the region being repainted
+    for (int side = 0; side < 2; ++side)
+    {
+        if (g.clipRegionIntersects (meterArea[side]))
+        {
+            drawMeterFill (g, meterArea[side], juce::jmax (0.0f, grMeter[side]));
+            paintedGr[side] = grMeter[side];
+        }
+    }
 
-    r.removeFromTop (10); // spacing
+    if (g.clipRegionIntersects (readoutArea))
+    {
+        drawReadouts (g);
+        std::copy (detectorDb, detectorDb + 2, paintedDetectorDb);
+        std::copy (outputPeakDb, outputPeakDb + 2, paintedOutputDb);
+    }
 
-    auto meterColumn = r.removeFromLeft (180);
+    if (g.clipRegionIntersects (traceArea))
+    {
+        drawTrace (g);
+        tracePainted = *std::max_element (grHistory, grHistory + historySize) > meterRepaintThresholdDb;
+    }
 
-    // Title area inside meter column
-    auto titleArea = meterColumn.removeFromTop (30);
-    g.setColour (juce::Colours::white);
-    g.drawText ("Gain Reduction (dB)", titleArea, juce::Justification::centredLeft);
+    if (g.clipRegionIntersects (statsArea))
+        drawFrameStats (g);
 
-    meterColumn.removeFromTop (10); // spacing under title
+    if (g.clipRegionIntersects (loudnessArea))
+    {
+        drawLoudness (g);
+        std::copy (std::begin (loudness), std::end (loudness), std::begin (paintedLoudness));
+    }
 
-    // Split remaining meterColumn into 2 meter rectangles
-    auto metersArea = meterColumn;
+    if (g.clipRegionIntersects (curveArea))
+    {
+        drawTransferCurve (g);
+        if (const auto* curve = processor.getGainCurve())
+        {
+            paintedCurve[0] = curve->thresholdDb;
+            paintedCurve[1] = curve->ratio;
+            paintedCurve[2] = curve->kneeDb;
+        }
+    }
 
-    const int meterWidth  = 50;
-    const int meterGap    = 20;
+    const double elapsedMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+    statsWindowMs += elapsedMs;
+    statsWindowMaxMs = juce::jmax (statsWindowMaxMs, elapsedMs);
+    ++statsWindowPaints;
+}
 
-    auto leftMeter  = metersArea.removeFromLeft (meterWidth);
-    metersArea.removeFromLeft (meterGap);
-    auto rightMeter = metersArea.removeFromLeft (meterWidth);
+// Everything that only changes on resize: background, titles, meter outlines and tick labels
+void StereoCompressorBuild1AudioProcessorEditor::drawStaticLayer (juce::Graphics& g) const
+{
+    g.fillAll (juce::Colours::black);
 
-    // Make meters taller by using all remaining height
-    leftMeter  = leftMeter.withHeight (meterColumn.getHeight()).withY (meterColumn.getY());
-    rightMeter = rightMeter.withHeight (meterColumn.getHeight()).withY (meterColumn.getY());
+    g.setColour (juce::Colours::white);
+    g.drawText ("Gain Reduction (dB)", titleArea, juce::Justification::centredLeft);
 
-auto drawMeter = [&] (juce::Rectangle<int> rMeter, float grDb)
-{
-    const float maxDb = 24.0f;
-    const float norm = juce::jlimit (0.0f, 1.0f, grDb / maxDb);
+    for (const auto& rMeter : meterArea)
+    {
+        // outline
+        g.setColour (juce::Colours::grey);
+        g.drawRect (rMeter);
+
+        // tick labels
+        g.setColour (juce::Colours::white.withAlpha (0.7f));
+        g.setFont (12.0f);
+        g.drawText ("0", rMeter.withHeight (16),
+                    juce::Justification::centredTop);
+        g.drawText ("-" + juce::String ((int) meterMaxDb),
+                    rMeter.withY (rMeter.getBottom() - 16).withHeight (16),
+                    juce::Justification::centredBottom);
+    }
 
-    // outline
     g.setColour (juce::Colours::grey);
-    g.drawRect (rMeter);
+    g.drawRect (traceArea);
 
-    // tick labels (optional)
+    // transfer display: frame and the 1:1 line
+    g.drawRect (curveArea);
+    const auto plot = curveArea.reduced (1).toFloat();
+    g.setColour (juce::Colours::grey.withAlpha (0.5f));
+    g.drawLine (plot.getX(), plot.getBottom(), plot.getRight(), plot.getY());
     g.setColour (juce::Colours::white.withAlpha (0.7f));
     g.setFont (12.0f);
-    g.drawText ("0", rMeter.withHeight (16),
-                juce::Justification::centredTop);
-    g.drawText ("-" + juce::String ((int) maxDb),
-                rMeter.withY (rMeter.getBottom() - 16).withHeight (16),
-                juce::Justification::centredBottom);
+    g.drawText ("In / Out (dB)", curveArea.reduced (4), juce::Justification::topLeft);
+}
+
+void StereoCompressorBuild1AudioProcessorEditor::drawMeterFill (juce::Graphics& g, juce::Rectangle<int> rMeter, float grDb) const
+{
+    const float norm = juce::jlimit (0.0f, 1.0f, grDb / meterMaxDb);
 
-    // fill grows DOWN from the top as GR increases
-    auto fill = rMeter;
-    fill.setY (rMeter.getY());
-    fill.setHeight ((int) (norm * rMeter.getHeight()));
+    // fill grows DOWN from the top as GR increases (inside the outline from the static layer)
+    auto fill = rMeter.reduced (1);
+    fill.setHeight ((int) (norm * (float) fill.getHeight()));
 
     g.setColour (juce::Colours::limegreen);
     g.fillRect (fill);
 
     // numeric readout
     g.setColour (juce::Colours::white);
+    g.setFont (12.0f);
     g.drawText (juce::String (grDb, 1) + " dB",
                 rMeter.reduced (2).removeFromTop (18),
                 juce::Justification::centred);
-};
+}
+
+void StereoCompressorBuild1AudioProcessorEditor::drawReadouts (juce::Graphics& g) const
+{
+    auto area = readoutArea;
+
+    g.setColour (juce::Colours::white.withAlpha (0.7f));
+    g.setFont (12.0f);
+    g.drawText ("Det " + juce::String (detectorDb[0], 1) + " / " + juce::String (detectorDb[1], 1) + " dB",
+                area.removeFromTop (18), juce::Justification::centredLeft);
+    g.drawText ("Out " + juce::String (outputPeakDb[0], 1) + " / " + juce::String (outputPeakDb[1], 1) + " dB",
+                area, juce::Justification::centredLeft);
+}
 
+// Scrolling trace: newest on the right, 0 dB GR at the top, meterMaxDb at the bottom
+void StereoCompressorBuild1AudioProcessorEditor::drawTrace (juce::Graphics& g) const
+{
+    const auto plot = traceArea.reduced (1).toFloat();
+    juce::Path trace;
 
-    drawMeter (leftMeter,  grL);
-    drawMeter (rightMeter, grR);
+    for (int i = 0; i < historySize; ++i)
+    {
+        const float grDb = grHistory[(historyPos + i) % historySize];
+        const float x = plot.getX() + plot.getWidth() * (float) i / (float) (historySize - 1);
+        const float y = plot.getY() + plot.getHeight() * juce::jlimit (0.0f, 1.0f, grDb / meterMaxDb);
+
+        if (i == 0) trace.startNewSubPath (x, y);
+        else        trace.lineTo (x, y);
+    }
+
+    g.saveState();
+    g.reduceClipRegion (traceArea.reduced (1)); // keep the stroke off the outline
+    g.setColour (juce::Colours::limegreen);
+    g.strokePath (trace, juce::PathStrokeType (1.0f));
+    g.restoreState();
+}
+
+// Static curve straight from the processor's gain table (the same one the audio thread uses),
+// input -60..0 dB across, output -60..0 dB up
+void StereoCompressorBuild1AudioProcessorEditor::drawTransferCurve (juce::Graphics& g) const
+{
+    const auto* curve = processor.getGainCurve();
+    if (curve == nullptr)
+        return;
+
+    constexpr float rangeDb = 60.0f;
+    const auto plot = curveArea.reduced (1).toFloat();
+    const int numPoints = juce::jmax (2, (int) plot.getWidth());
+    juce::Path path;
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+        const float inDb = -rangeDb + rangeDb * (float) i / (float) (numPoints - 1);
+        const float outDb = inDb + curve->getGainDb (inDb);
+        const float x = plot.getX() + plot.getWidth() * (float) i / (float) (numPoints - 1);
+        const float y = plot.getBottom() - plot.getHeight() * juce::jlimit (0.0f, 1.0f, (outDb + rangeDb) / rangeDb);
+
+        if (i == 0) path.startNewSubPath (x, y);
+        else        path.lineTo (x, y);
+    }
+
+    g.saveState();
+    g.reduceClipRegion (curveArea.reduced (1));
+    g.setColour (juce::Colours::limegreen);
+    g.strokePath (path, juce::PathStrokeType (1.5f));
+    g.restoreState();
+}
+
+// One line per stream: momentary / short-term / integrated LUFS and true peak
+void StereoCompressorBuild1AudioProcessorEditor::drawLoudness (juce::Graphics& g) const
+{
+    auto area = loudnessArea;
+    g.setColour (juce::Colours::white.withAlpha (0.7f));
+    g.setFont (12.0f);
+
+    const auto lufs = [] (float value) { return value > LoudnessMeter::minLufs ? juce::String (value, 1) : juce::String ("-inf"); };
+
+    for (int s = 0; s < LoudnessAnalyser::numStreams; ++s)
+    {
+        const auto& r = loudness[s];
+        juce::String text;
+        text << (s == LoudnessAnalyser::input ? "In   " : "Out  ")
+             << "M " << lufs (r.momentaryLufs) << "   S " << lufs (r.shortTermLufs)
+             << "   I " << lufs (r.integratedLufs) << " LUFS   TP " << juce::String (r.truePeakDb, 1) << " dBTP";
+        if (r.droppedSamples > 0)
+            text << "   (" << juce::String ((juce::int64) r.droppedSamples) << " samples not analysed)";
+
+        g.drawText (text, area.removeFromTop (loudnessArea.getHeight() / 2), juce::Justification::centredLeft);
+    }
+}
+
+void StereoCompressorBuild1AudioProcessorEditor::drawFrameStats (juce::Graphics& g) const
+{
+    g.setColour (juce::Colours::white.withAlpha (0.5f));
+    g.setFont (12.0f);
+
+    auto area = statsArea;
+   #if STEREOCOMP_INSTRUMENTATION
+    // second line: processBlock since prepareToPlay (late = over the deadline fraction of the buffer)
+    const auto& a = audioStats;
+    g.drawText ("audio p99 " + juce::String (a.getPercentileNs (0.99) / 1000.0, 1) + " us, max "
+                    + juce::String (a.maxNs / 1000.0, 1) + " us, " + juce::String ((juce::int64) a.numOverDeadline) + " late, "
+                    + juce::String ((juce::int64) a.nonFiniteSamples) + " nan/inf, "
+                    + juce::String ((juce::int64) a.denormalSamples) + " denormal, "
+                    + juce::String ((juce::int64) a.realtimeViolations) + " rt",
+                area.removeFromBottom (area.getHeight() / 2), juce::Justification::centredRight);
+   #endif
+
+    g.drawText ("paint " + juce::String (frameStats.averageMs, 3) + " ms avg, "
+                    + juce::String (frameStats.maxMs, 3) + " max, "
+                    + juce::String (frameStats.paintsPerSecond) + "/s, idle "
+                    + juce::String (juce::roundToInt (frameStats.idleBlocksPercent)) + "% of blocks",
+                area, juce::Justification::centredRight);
+}
+
+// Pull everything the audio thread has pushed since the last tick. Never blocks the audio thread:
+// if we fall behind, the processor drops frames rather than waiting for us.
+void StereoCompressorBuild1AudioProcessorEditor::drainMeterFrames()
+{
+    const double sampleRate = processor.getSampleRate() > 0.0 ? processor.getSampleRate() : 44100.0;
+    constexpr double releaseSeconds = 0.3;
+
+    MeterFrame frame;
+    while (processor.popMeterFrame (frame))
+    {
+        // fast attack, slow release, scaled by how much audio the frame covers
+        const float release = (float) std::exp (-(double) frame.numSamples / (releaseSeconds * sampleRate));
+
+        for (int side = 0; side < 2; ++side)
+        {
+            grMeter[side] = juce::jmax (frame.gainReductionDb[side], grMeter[side] * release);
+            detectorDb[side] = frame.detectorDb[side];
+            outputPeakDb[side] = frame.outputPeakDb[side];
+        }
+
+        grHistory[historyPos] = juce::jmax (frame.gainReductionDb[0], frame.gainReductionDb[1]);
+        historyPos = (historyPos + 1) % historySize;
+        historyChanged = true;
+    }
 }
 
 void StereoCompressorBuild1AudioProcessorEditor::timerCallback()
 {
-    repaint();
+    drainMeterFrames();
+
+    // the active slot can also change under us (session recall)
+    for (int slot = 0; slot < 2; ++slot)
+        presetButtons[slot].setToggleState (processor.getActivePresetSlot() == slot, juce::dontSendNotification);
+
+    // Repaint only the rectangles whose value moved enough to show
+    const auto moved = [] (float a, float b) { return std::abs (a - b) > meterRepaintThresholdDb; };
+
+    for (int side = 0; side < 2; ++side)
+        if (moved (grMeter[side], paintedGr[side]))
+            repaint (meterArea[side]);
+
+    if (moved (detectorDb[0], paintedDetectorDb[0]) || moved (detectorDb[1], paintedDetectorDb[1])
+        || moved (outputPeakDb[0], paintedOutputDb[0]) || moved (outputPeakDb[1], paintedOutputDb[1]))
+        repaint (readoutArea);
+
+    // the trace scrolls with every frame, but a flat line at 0 dB scrolling is still a flat line
+    if (historyChanged)
+    {
+        const bool hasGr = *std::max_element (grHistory, grHistory + historySize) > meterRepaintThresholdDb;
+        if (hasGr || tracePainted)
+            repaint (traceArea);
+        historyChanged = false;
+    }
+
+    // loudness: the analysis thread publishes every few ms, repaint when a shown value moved
+    for (int s = 0; s < LoudnessAnalyser::numStreams; ++s)
+    {
+        loudness[s] = processor.getLoudnessAnalyser().getReading ((LoudnessAnalyser::Stream) s);
+        const auto& a = loudness[s];
+        const auto& b = paintedLoudness[s];
+        if (moved (a.momentaryLufs, b.momentaryLufs) || moved (a.shortTermLufs, b.shortTermLufs)
+            || moved (a.integratedLufs, b.integratedLufs) || moved (a.truePeakDb, b.truePeakDb)
+            || a.droppedSamples != b.droppedSamples)
+            repaint (loudnessArea);
+    }
+
+    // transfer display follows the published table (rebuilt by the processor when threshold / ratio / knee move)
+    if (const auto* curve = processor.getGainCurve())
+        if (curve->thresholdDb != paintedCurve[0] || curve->ratio != paintedCurve[1] || curve->kneeDb != paintedCurve[2])
+            repaint (curveArea);
+
+    // frame-time counter, published once a second
+    const double now = juce::Time::getMillisecondCounterHiRes();
+    if (now - statsWindowStart >= 1000.0)
+    {
+        frameStats.averageMs = statsWindowPaints > 0 ? statsWindowMs / statsWindowPaints : 0.0;
+        frameStats.maxMs = statsWindowMaxMs;
+        frameStats.paintsPerSecond = juce::roundToInt (statsWindowPaints * 1000.0 / (now - statsWindowStart));
+
+        const auto skipped = processor.getNumSkippedBlocks(), total = processor.getNumBlocks();
+        frameStats.idleBlocksPercent = total > statsTotalBlocks && skipped >= statsSkippedBlocks // counters restart in prepareToPlay
+                                         ? 100.0 * (double) (skipped - statsSkippedBlocks) / (double) (total - statsTotalBlocks)
+                                         : 0.0;
+        statsSkippedBlocks = skipped;
+        statsTotalBlocks = total;
+       #if STEREOCOMP_INSTRUMENTATION
+        audioStats = processor.getAudioThreadStats();
+       #endif
+
+        statsWindowStart = now;
+        statsWindowMs = statsWindowMaxMs = 0.0;
+        statsWindowPaints = 0;
+        repaint (statsArea);
+    }
 }
+
 void StereoCompressorBuild1AudioProcessorEditor::resized()
 {
     auto r = getLocalBounds().reduced (10);
 
-    // top row controls
-    detectorModeBox.setBounds (r.removeFromTop (30).removeFromLeft (140));
+    // top row controls, paint-time counter on the right
+    auto topRow = r.removeFromTop (30);
+    detectorModeBox.setBounds (topRow.removeFromLeft (140));
+    topRow.removeFromLeft (10);
+    presetButtons[0].setBounds (topRow.removeFromLeft (30));
+    presetButtons[1].setBounds (topRow.removeFromLeft (30));
+    topRow.removeFromLeft (10);
+    loudnessResetButton.setBounds (topRow.removeFromLeft (70));
+    statsArea = topRow.removeFromRight (420);
 
     r.removeFromTop (10); // little spacing
 
+    // loudness lines along the bottom, full width
+    loudnessArea = r.removeFromBottom (36);
+    r.removeFromBottom (6);
+
     // left meter column
     auto meterColumn = r.removeFromLeft (180);
 
+    titleArea = meterColumn.removeFromTop (30);
+    meterColumn.removeFromTop (10); // spacing under title
+
+    // Scrolling gain-reduction trace along the bottom of the column, detector / output readouts above it
+    traceArea = meterColumn.removeFromBottom (100);
+    readoutArea = meterColumn.removeFromBottom (36);
+    meterColumn.removeFromBottom (6);
+    curveArea = meterColumn.removeFromBottom (meterColumn.getWidth()).withSizeKeepingCentre (170, 170);
+    meterColumn.removeFromBottom (6);
+
+    // two meters, using all remaining height
+    const int meterWidth  = 50;
+    const int meterGap    = 20;
+
+    meterArea[0] = meterColumn.removeFromLeft (meterWidth);
+    meterColumn.removeFromLeft (meterGap);
+    meterArea[1] = meterColumn.removeFromLeft (meterWidth);
+
     // Generic editor takes the rest
     if (genericEditor)
         genericEditor->setBounds (r);
-}
-
-StereoCompressorBuild1AudioProcessorEditor::~StereoCompressorBuild1AudioProcessorEditor() = default;
 
+    staticLayer = {}; // redrawn at the new size on the next paint
+}
 
+StereoCompressorBuild1AudioProcessorEditor::~StereoCompressorBuild1AudioProcessorEditor()
+{
+    processor.getLoudnessAnalyser().setEnabled (false);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Instrumentation.h"
+#include "LoudnessAnalyser.h"
 
 
 class StereoCompressorBuild1AudioProcessor;
@@ -17,14 +19,74 @@ public:
     void resized() override;
     void timerCallback() override;
 
+    // Time spent in paint(), averaged / maxed over the last second (message thread)
+    struct FrameStats
+    {
+        double averageMs = 0.0;
+        double maxMs = 0.0;
+        int paintsPerSecond = 0;
+        double idleBlocksPercent = 0.0; // processor blocks skipped by its idle path over the same second
+    };
+    FrameStats getFrameStats() const noexcept { return frameStats; }
+
 private:
     StereoCompressorBuild1AudioProcessor& processor;
 
     juce::ComboBox detectorModeBox;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> detectorModeAttach;
 
+    juce::TextButton presetButtons[2]; // A / B compare slots; lit = the slot being edited
+    juce::TextButton loudnessResetButton; // integrated loudness, maxima and true peak start again
+
     std::unique_ptr<juce::AudioProcessorEditor> genericEditor;
 
+    // Meter state, fed from the processor's meter ring in timerCallback (message thread only)
+    void drainMeterFrames();
+
+    float grMeter[2] {};       // with ballistics (instant attack, ~300 ms release), positive dB
+    float detectorDb[2] = { -100.0f, -100.0f };
+    float outputPeakDb[2] = { -100.0f, -100.0f };
+
+    static constexpr int historySize = 512; // one point per meter frame, ~1 s at 2 ms per frame
+    float grHistory[historySize] {};        // max of L / R, oldest at historyPos
+    int historyPos = 0;
+    bool historyChanged = false;            // new frames since the trace was last repainted
+
+    // ---- Rendering: the layout is computed in resized(); paint() blits the static layer
+    // (background, outlines, labels, ticks) and draws only what moves on top of it ----
+    void drawStaticLayer (juce::Graphics&) const;
+    void drawMeterFill (juce::Graphics&, juce::Rectangle<int> meter, float grDb) const;
+    void drawReadouts (juce::Graphics&) const;
+    void drawTrace (juce::Graphics&) const;
+    void drawFrameStats (juce::Graphics&) const;
+    void drawTransferCurve (juce::Graphics&) const;
+    void drawLoudness (juce::Graphics&) const;
+
+    juce::Rectangle<int> titleArea, meterArea[2], readoutArea, traceArea, statsArea, curveArea, loudnessArea;
+
+    juce::Image staticLayer; // cached at the display scale it was drawn for
+    float staticLayerScale = 0.0f;
+
+    // What's currently on screen, so the timer can skip repaints that wouldn't change anything
+    static constexpr float meterRepaintThresholdDb = 0.1f;
+    float paintedGr[2] { -1.0f, -1.0f };
+    float paintedDetectorDb[2] {}, paintedOutputDb[2] {};
+    bool tracePainted = false; // the trace on screen shows some gain reduction
+    float paintedCurve[3] { -1.0f, -1.0f, -1.0f }; // threshold / ratio / knee of the table on screen
+
+    // Input / output loudness as the analysis thread last published it, and what's on screen
+    LoudnessAnalyser::Reading loudness[LoudnessAnalyser::numStreams], paintedLoudness[LoudnessAnalyser::numStreams];
+
+    // Frame-time counter
+    FrameStats frameStats;
+    double statsWindowMs = 0.0, statsWindowMaxMs = 0.0;
+    int statsWindowPaints = 0;
+    double statsWindowStart = 0.0;
+    juce::uint64 statsSkippedBlocks = 0, statsTotalBlocks = 0; // processor counters at the window start
+   #if STEREOCOMP_INSTRUMENTATION
+    AudioThreadMonitor::Stats audioStats; // the processor's audio-thread counters, refreshed with the frame stats
+   #endif
+
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StereoCompressorBuild1AudioProcessorEditor)
 };
@@ -8,12 +8,136 @@ static float ratioFromChoiceIndex (int idx)
     return ratios[idx]; 
 } //Helper function to convert choice index to ratio value.
 
+// Binary state chunk (little-endian):
+//   int32 magic, uint8 version, uint8 active A/B slot,
+//   then three sections - current settings, slot A, slot B - each a uint16 count followed by
+//   count x { uint32 parameter ID hash, float32 plain value }.
+// Parameters are matched by ID hash, so chunks survive parameters being added or removed (missing ones
+// take their default, unknown ones are skipped). An empty preset slot is a section with count 0.
+// Anything without the magic is treated as the APVTS XML chunk older versions wrote.
+static constexpr int stateMagic = 0x54534353; // "SCST"
+static constexpr int stateVersion = 1;
+
+// BS.1770 channel weight: 1.41 for the surrounds beside the listener, nothing for the LFE, 1 for the rest
+static float loudnessWeight (juce::AudioChannelSet::ChannelType type) noexcept
+{
+    using Set = juce::AudioChannelSet;
+
+    switch (type)
+    {
+        case Set::LFE:
+        case Set::LFE2:
+            return 0.0f;
+
+        case Set::leftSurround:
+        case Set::rightSurround:
+        case Set::leftSurroundSide:
+        case Set::rightSurroundSide:
+            return 1.41f;
+
+        default:
+            return 1.0f;
+    }
+}
+
+static uint32_t hashParameterId (const juce::String& id) noexcept // FNV-1a over the UTF-8 bytes
+{
+    uint32_t h = 2166136261u;
+    for (auto p = id.toRawUTF8(); *p != 0; ++p)
+        h = (h ^ (uint8_t) *p) * 16777619u;
+    return h;
+}
+
 StereoCompressorBuild1AudioProcessor::StereoCompressorBuild1AudioProcessor()
-     : AudioProcessor (BusesProperties() //Tells the host that it's stereo input and stereo output.
+     : AudioProcessor (BusesProperties() //Stereo by default; isBusesLayoutSupported also takes 5.1, 7.1 and 7.1.4
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)),
+                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)), // optional external key
        apvts(*this, nullptr, "Parameters", createParameterLayout()) // Initialize the APVTS with the processor, no undo manager, a unique ID, and the parameter layout
-{}
+{
+    // Resolve the parameter atomics once; processBlock only does the loads
+    bypassParam       = apvts.getRawParameterValue ("bypass");
+    gainParam         = apvts.getRawParameterValue ("gain");
+    detectorModeParam = apvts.getRawParameterValue ("detectorMode");
+    scHpfOnParam      = apvts.getRawParameterValue ("scHPfOn");
+    scHpfFreqParam    = apvts.getRawParameterValue ("scHpfFreq");
+    unlinkParam       = apvts.getRawParameterValue ("unlink");
+    thresholdParam    = apvts.getRawParameterValue ("threshold");
+    kneeParam         = apvts.getRawParameterValue ("knee");
+    makeupParam       = apvts.getRawParameterValue ("makeup");
+    ratioParam        = apvts.getRawParameterValue ("ratio");
+    attackParam       = apvts.getRawParameterValue ("attack");
+    releaseParam      = apvts.getRawParameterValue ("release");
+    lookaheadParam    = apvts.getRawParameterValue ("lookahead");
+    oversamplingParam = apvts.getRawParameterValue ("oversampling");
+    osFilterParam     = apvts.getRawParameterValue ("osFilter");
+    linkModeParam     = apvts.getRawParameterValue ("linkMode");
+
+    scSourceParam   = apvts.getRawParameterValue ("scSource");
+    extHpfOnParam   = apvts.getRawParameterValue ("extHpfOn");
+    extHpfFreqParam = apvts.getRawParameterValue ("extHpfFreq");
+
+    mbModeParam = apvts.getRawParameterValue ("mbMode");
+    for (int i = 0; i < 3; ++i)
+        xoverParam[i] = apvts.getRawParameterValue ("xover" + juce::String (i + 1));
+
+    for (int b = 0; b < MultibandCompressor::maxBands; ++b)
+    {
+        const juce::String id ("band" + juce::String (b + 1));
+        bandThresholdParam[b] = apvts.getRawParameterValue (id + "Threshold");
+        bandRatioParam[b]     = apvts.getRawParameterValue (id + "Ratio");
+        bandAttackParam[b]    = apvts.getRawParameterValue (id + "Attack");
+        bandReleaseParam[b]   = apvts.getRawParameterValue (id + "Release");
+        bandKneeParam[b]      = apvts.getRawParameterValue (id + "Knee");
+    }
+
+    for (auto* p : getParameters())
+    {
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (p))
+        {
+            const auto id = ranged->getParameterID();
+            stateParameters.push_back ({ ranged, apvts.getRawParameterValue (id), hashParameterId (id) });
+
+            for (size_t i = 0; i + 1 < stateParameters.size(); ++i)
+                jassert (stateParameters[i].idHash != stateParameters.back().idHash); // rename one of them
+        }
+    }
+
+    updateGainCurve();
+    startTimerHz (20); // picks up threshold / ratio / knee changes and rebuilds the table
+}
+
+StereoCompressorBuild1AudioProcessor::~StereoCompressorBuild1AudioProcessor()
+{
+    stopTimer();
+}
+
+// Message thread. Builds a new table when the curve parameters no longer match the published one;
+// the audio thread keeps using the old table (or the GainComputer) until the swap.
+void StereoCompressorBuild1AudioProcessor::updateGainCurve()
+{
+    const float thresholdDb = thresholdParam->load();
+    const float ratio = ratioFromChoiceIndex ((int) ratioParam->load());
+    const float kneeDb = kneeParam->load();
+
+    const auto* current = gainCurve.getCurrent();
+    if (current != nullptr && current->matches (thresholdDb, ratio, kneeDb))
+    {
+        gainCurve.collectGarbage(); // anything the audio thread was still holding last time
+        return;
+    }
+
+    gainCurve.publish (std::make_unique<GainCurveTable> (thresholdDb, ratio, kneeDb));
+}
+
+void StereoCompressorBuild1AudioProcessor::setDspPaths (const DspPaths& paths) noexcept
+{
+    core.setSpecialisedLoops (paths.specialisedLoops);
+    core.setStereoPairLoop (paths.stereoPairLoop);
+    core.setReferenceGainCurve (! paths.simdGainCurve);
+    useCurveTable = paths.curveTable;
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout 
 StereoCompressorBuild1AudioProcessor::createParameterLayout()
 {
@@ -71,177 +195,602 @@ StereoCompressorBuild1AudioProcessor::createParameterLayout()
         "makeup", "Makeup Gain (dB)",
         juce::NormalisableRange<float>(-12.0f, 24.0f, 0.1f), 0.0f
     ));
+    params.push_back (std::make_unique<juce::AudioParameterFloat>(
+        "lookahead", "Lookahead (ms)",
+        juce::NormalisableRange<float>(0.0f, maxLookaheadMs, 0.1f), 0.0f
+    )); //0 = off. Adds this much latency (reported to the host)
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "oversampling", "Oversampling",
+        juce::StringArray { "1x", "2x", "4x" },
+        0
+    )); //detector + gain multiply run at this rate (less aliasing with fast attacks / hard knee)
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "osFilter", "Oversampling Filter",
+        juce::StringArray { "IIR (low latency)", "FIR (linear phase)" },
+        0
+    ));
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "linkMode", "Link Channels",
+        juce::StringArray { "All", "All except LFE", "Fronts / Surrounds" },
+        0
+    )); //which channels share a detector; "unlink" still blends toward per-channel. Same thing on stereo.
+
+    // ---- External sidechain ----
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "scSource", "Key Source",
+        juce::StringArray { "Internal", "External" },
+        0
+    )); //External = the sidechain input bus (falls back to Internal when nothing is connected)
+    params.push_back (std::make_unique<juce::AudioParameterBool>(
+        "extHpfOn", "External Key High-Pass Filter On", false
+    ));
+    params.push_back (std::make_unique<juce::AudioParameterFloat>(
+        "extHpfFreq", "External Key High-Pass Filter Frequency (Hz)",
+        juce::NormalisableRange<float>(20.0f, 1000.0f, 1.0f, 0.5f), 80.0f
+    ));
+
+    // ---- Multiband ----
+    params.push_back (std::make_unique<juce::AudioParameterChoice>(
+        "mbMode", "Multiband",
+        juce::StringArray { "Off", "3 Bands", "4 Bands" },
+        0
+    )); //Off = the single-band compressor above
+    params.push_back (std::make_unique<juce::AudioParameterFloat>(
+        "xover1", "Crossover 1 (Hz)",
+        juce::NormalisableRange<float>(20.0f, 1000.0f, 1.0f, 0.3f), 120.0f
+    ));
+    params.push_back (std::make_unique<juce::AudioParameterFloat>(
+        "xover2", "Crossover 2 (Hz)",
+        juce::NormalisableRange<float>(200.0f, 8000.0f, 1.0f, 0.3f), 1000.0f
+    ));
+    params.push_back (std::make_unique<juce::AudioParameterFloat>(
+        "xover3", "Crossover 3 (Hz)",
+        juce::NormalisableRange<float>(1000.0f, 18000.0f, 1.0f, 0.3f), 5000.0f
+    )); //only used in 4-band mode
+
+    for (int b = 1; b <= MultibandCompressor::maxBands; ++b) //same ranges as the broadband controls
+    {
+        const juce::String id ("band" + juce::String (b));
+        const juce::String name ("Band " + juce::String (b) + " ");
+
+        params.push_back (std::make_unique<juce::AudioParameterFloat>(
+            id + "Threshold", name + "Threshold (dB)",
+            juce::NormalisableRange<float>(-60.0f, 0.0f, 0.1f), -18.0f
+        ));
+        params.push_back (std::make_unique<juce::AudioParameterChoice>(
+            id + "Ratio", name + "Ratio",
+            juce::StringArray {"1.5:1", "3:1", "4:1","6:1", "10:1", "20:1"},
+            2
+        ));
+        params.push_back (std::make_unique<juce::AudioParameterFloat>(
+            id + "Attack", name + "Attack (ms)",
+            juce::NormalisableRange<float>(0.1f, 100.0f, 0.1f, 0.5f), 10.0f
+        ));
+        params.push_back (std::make_unique<juce::AudioParameterFloat>(
+            id + "Release", name + "Release (ms)",
+            juce::NormalisableRange<float>(10.0f, 1000.0f, 1.0f, 0.5f), 100.0f
+        ));
+        params.push_back (std::make_unique<juce::AudioParameterFloat>(
+            id + "Knee", name + "Knee (dB)",
+            juce::NormalisableRange<float>(0.0f, 12.0f, 0.1f), 6.0f
+        ));
+    }
 return { params.begin(), params.end() };
 }
 //Prepare to Play
-void StereoCompressorBuild1AudioProcessor::prepareToPlay (double sampleRate, int)
+void StereoCompressorBuild1AudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     currentSampleRate = sampleRate;
+    if (juce::MessageManager::existsAndIsCurrentThread())
+        updateGainCurve(); // so the first block already has a table (otherwise the timer catches up)
+
+    maxChunkSize = juce::jmax (1, samplesPerBlock); // bigger host blocks get processed in chunks
+
+    meterIntervalSamples = juce::jmax (16, (int) std::lround (sampleRate * 0.002));
+    pendingMeterSamples = 0;
+
+    skippedBlocks.store (0);
+    totalBlocks.store (0);
+
+   #if STEREOCOMP_INSTRUMENTATION
+    audioThreadMonitor.prepare (sampleRate);
+    audioThreadMonitor.reset();
+   #endif
+
+    // bus width and what each channel is (for the link groups)
+    const auto layout = getChannelLayoutOfBus (true, 0);
+    numProcessChannels = juce::jlimit (1, maxChannels, layout.size() > 0 ? layout.size() : 2);
+    for (int ch = 0; ch < numProcessChannels; ++ch)
+        channelTypes[ch] = layout.size() > 0 ? layout.getTypeOfChannel (ch) : juce::AudioChannelSet::unknown;
+    updateLinkGroups ((int) linkModeParam->load());
+
+    float loudnessWeights[maxChannels] {};
+    for (int ch = 0; ch < numProcessChannels; ++ch)
+        loudnessWeights[ch] = loudnessWeight (channelTypes[ch]);
+    loudnessAnalyser.prepare (sampleRate, numProcessChannels, loudnessWeights, maxChunkSize);
+
+    // sidechain bus: 0 channels when the host hasn't enabled it
+    const auto* sidechain = getBus (true, 1);
+    sidechainChannels = sidechain != nullptr && sidechain->isEnabled() ? sidechain->getNumberOfChannels() : 0;
+
+    // Core scratch holds one chunk at the highest oversampling rate, and the lookahead buffers the longest
+    // setting at that rate; changing the time later never allocates. Delay lines for the precision the host
+    // will call us with (it's fixed before prepareToPlay).
+    core.allocate (numProcessChannels, maxChunkSize * maxOversamplingFactor,
+                   CompressorCore::maxLookaheadSamplesFor (sampleRate * maxOversamplingFactor), isUsingDoublePrecision());
+    core.setLinkGroups (linkGroup, numLinkGroups);
+
+    // parameters only change between blocks, so a ramp shorter than the block would still leave steps
+    smoothingSeconds = juce::jmax (minSmoothingSeconds, samplesPerBlock / sampleRate);
+    core.setSmoothingTime (smoothingSeconds);
+
+    // oversamplers for that precision
+    if (isUsingDoublePrecision())
+    {
+        prepareAudioPath (doublePath);
+        floatPath = {};
+    }
+    else
+    {
+        prepareAudioPath (floatPath);
+        doublePath = {};
+    }
 
-    envL.prepare (sampleRate); //prepares left envelope follower (peak)
-    envR.prepare (sampleRate); //prepares right envelope follower (peak)
+    // the core gets (re)prepared at the processing rate, then picks up the parameters (and the latency)
+    setOversampling ((int) oversamplingParam->load(), (int) osFilterParam->load());
+    updateCoefficients (readParameters());
+    reportLatency();
+}
 
-    rmsL.prepare (sampleRate);
-    rmsR.prepare (sampleRate); //prepares RMS followers
-    
-    scHpfL.prepare (sampleRate);
-    scHpfR.prepare (sampleRate);
+// Every oversampler is built here, so switching factor / filter later doesn't allocate
+template <typename Sample>
+void StereoCompressorBuild1AudioProcessor::prepareAudioPath (AudioPath<Sample>& path)
+{
+    using Oversampling = juce::dsp::Oversampling<Sample>;
 
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
-} //No DSP state yet. Will use this later for envelope filters, followers etc.
+    for (int filter = 0; filter < 2; ++filter)
+    {
+        for (int stages = 1; stages <= 2; ++stages) // 2x, 4x
+        {
+            auto& os = path.oversamplers[filter][stages - 1];
+            os = std::make_unique<Oversampling> (
+                (size_t) numProcessChannels, (size_t) stages,
+                filter == 0 ? Oversampling::filterHalfBandPolyphaseIIR
+                            : Oversampling::filterHalfBandFIREquiripple,
+                true);
+            os->initProcessing ((size_t) maxChunkSize);
+        }
+    }
+}
 
-bool StereoCompressorBuild1AudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
+// Picks one of the preallocated oversamplers and re-prepares everything that depends on the rate. Not the
+// audio thread: prepareToPlay, or applyOversamplingChange with processing suspended. The core, the
+// oversampler and the idle count all start from zero, so a change while audio is playing clicks (the
+// filters' and followers' state is dropped mid-signal) - as any host restart would.
+void StereoCompressorBuild1AudioProcessor::setOversampling (int factorIndex, int filterIndex)
 {
-    return layouts.getMainInputChannelSet() == juce::AudioChannelSet::stereo()
-        && layouts.getMainOutputChannelSet() == juce::AudioChannelSet::stereo();
-} //Only supports stereo in and out.
+    factorIndex = juce::jlimit (0, 2, factorIndex);
+    filterIndex = juce::jlimit (0, 1, filterIndex);
 
+    oversamplingIndex = factorIndex;
+    osFilterIndex = filterIndex;
+    oversamplingFactor = 1 << factorIndex;
 
-void StereoCompressorBuild1AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& )
-{
-    if (buffer.getNumChannels() < 2) return;
+    auto selectOversampler = [factorIndex, filterIndex] (auto& path)
+    {
+        path.activeOversampler = factorIndex > 0 ? path.oversamplers[filterIndex][factorIndex - 1].get() : nullptr;
+        if (path.activeOversampler != nullptr)
+            path.activeOversampler->reset();
+    };
+    selectOversampler (floatPath);  // only one of the two is built; the other stays nullptr
+    selectOversampler (doublePath);
 
-    juce::ScopedNoDenormals noDenormals;
-    // Clear any output channels that don't have input data
-auto totalNumInputChannels  = getTotalNumInputChannels();
-auto totalNumOutputChannels = getTotalNumOutputChannels();
+    core.setSampleRate (currentSampleRate * oversamplingFactor); // state cleared, coefficients recomputed on the next update
 
-float maxGRDbL = 0.0f;
-float maxGRDbR = 0.0f;
+    idle = false; // state was just reset; count the silence again from here
+    silentSamples = 0;
 
-for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-    buffer.clear (i, 0, buffer.getNumSamples());
+    updateLatency();
+}
+
+// Message thread (the timer): a factor / filter change the parameters ask for. suspendProcessing takes the
+// callback lock, so this waits for a processBlock in progress and the next one sees the new setup; the
+// blocks in between are skipped by the wrapper.
+void StereoCompressorBuild1AudioProcessor::applyOversamplingChange()
+{
+    const int factorIndex = (int) oversamplingParam->load();
+    const int filterIndex = (int) osFilterParam->load();
 
-//PARAMETER READS
-    const bool bypass = apvts.getRawParameterValue("bypass")->load() > 0.5f; //Get bypass parameter value
-    if (bypass) return;  // Pulls the DAW/UI Value and exits early if bypassed
+    if (maxChunkSize == 0 || (factorIndex == oversamplingIndex && filterIndex == osFilterIndex))
+        return; // not prepared (prepareToPlay will pick it up), or nothing to do
+
+    suspendProcessing (true);
+    setOversampling (factorIndex, filterIndex);
+    suspendProcessing (false);
+
+    reportLatency();
+}
 
-    const float gainDb = apvts.getRawParameterValue("gain")->load(); //Get gain parameter value
+bool StereoCompressorBuild1AudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
+{
+    const auto& in  = layouts.getMainInputChannelSet();
+    const auto& out = layouts.getMainOutputChannelSet();
 
-    const int detectorMode = (int) apvts.getRawParameterValue ("detectorMode")->load(); // 0=Peak, 1=RMS
+    if (in != out) return false;
 
-    const bool scHpfOn = apvts.getRawParameterValue("scHPfOn")->load() > 0.5f; //Get sidechain HPF on/off parameter value
-    const float scHpfFreq = apvts.getRawParameterValue("scHpfFreq")->load(); //Get sidechain HPF frequency parameter value
-    if (scHpfOn)
+    if (layouts.inputBuses.size() > 1)
     {
-        scHpfL.setCutoff (scHpfFreq);
-        scHpfR.setCutoff (scHpfFreq);
+        const auto& sc = layouts.getChannelSet (true, 1);
+        if (! sc.isDisabled() && sc != juce::AudioChannelSet::mono() && sc != juce::AudioChannelSet::stereo())
+            return false;
     }
-    const float unlinkPct = apvts.getRawParameterValue("unlink")->load(); // 0..100
-    const float unlink = juce::jlimit (0.0f, 1.0f, unlinkPct / 100.0f);   // 0..1
-    const float link = 1.0f - unlink; // 1=linked, 0=unlinked
 
-    const float thresholdDb = apvts.getRawParameterValue("threshold")->load(); //Get threshold parameter value
-    const float kneeDb = apvts.getRawParameterValue("knee")->load(); //Get knee parameter value
-    const float makeupDb = apvts.getRawParameterValue("makeup")->load(); //Get makeup gain parameter value
+    return in == juce::AudioChannelSet::stereo()
+        || in == juce::AudioChannelSet::create5point1()
+        || in == juce::AudioChannelSet::create7point1()
+        || in == juce::AudioChannelSet::create7point1point4();
+} //Same layout in and out: stereo, 5.1, 7.1 or 7.1.4. Sidechain: off, mono or stereo.
 
-    const int ratioIndex = (int) apvts.getRawParameterValue("ratio")->load();
-    const float ratio = ratioFromChoiceIndex (ratioIndex);
+// linkMode 0: one group. 1: LFE gets its own detector. 2: fronts, surrounds (incl. heights) and LFE kept apart.
+// Runs on the audio thread when the parameter changes: only touches the fixed arrays.
+void StereoCompressorBuild1AudioProcessor::updateLinkGroups (int linkMode)
+{
+    linkModeIndex = linkMode;
 
-    const float attackMs = apvts.getRawParameterValue("attack") ->load();
-    const float releaseMs = apvts.getRawParameterValue("release") ->load();
+    auto isLfe = [] (juce::AudioChannelSet::ChannelType t)
+    {
+        return t == juce::AudioChannelSet::LFE || t == juce::AudioChannelSet::LFE2;
+    };
 
-    envL.updateTimeConstants (attackMs, releaseMs); //update peak envelope follower time constants
-    envR.updateTimeConstants (attackMs, releaseMs);
-    rmsL.updateTimeConstants (attackMs, releaseMs); //update RMS follower time constants
-    rmsR.updateTimeConstants (attackMs, releaseMs);
+    auto isFront = [] (juce::AudioChannelSet::ChannelType t)
+    {
+        return t == juce::AudioChannelSet::left || t == juce::AudioChannelSet::right
+            || t == juce::AudioChannelSet::centre
+            || t == juce::AudioChannelSet::leftCentre || t == juce::AudioChannelSet::rightCentre
+            || t == juce::AudioChannelSet::wideLeft || t == juce::AudioChannelSet::wideRight
+            || t == juce::AudioChannelSet::unknown;
+    };
+
+    // 0 = everything / fronts; the surrounds and each excluded channel get a group only when one turns up,
+    // so a bus that ends up in one group (stereo, whatever the mode) lets the core take its stereo pair loop
+    numLinkGroups = 1;
+    int surroundGroup = -1;
+
+    for (int ch = 0; ch < numProcessChannels; ++ch)
+    {
+        const auto type = channelTypes[ch];
+
+        if (linkMode == 0)
+            linkGroup[ch] = 0;
+        else if (isLfe (type))
+            linkGroup[ch] = numLinkGroups++;
+        else if (linkMode == 1 || isFront (type))
+            linkGroup[ch] = 0;
+        else
+        {
+            if (surroundGroup < 0)
+                surroundGroup = numLinkGroups++;
+            linkGroup[ch] = surroundGroup;
+        }
+    }
 
+    core.setLinkGroups (linkGroup, numLinkGroups);
+}
 
-    const float inputGain  = juce::Decibels::decibelsToGain (gainDb);
-    const float makeupGain = juce::Decibels::decibelsToGain (makeupDb);
 
-    constexpr float eps = 1.0e-9f;
+// The same snapshot from any source of plain values (the atomics, or a preset about to be applied)
+template <typename ValueOf>
+StereoCompressorBuild1AudioProcessor::ParamSnapshot StereoCompressorBuild1AudioProcessor::makeSnapshot (ValueOf&& valueOf) const noexcept
+{
+    ParamSnapshot p;
+    p.bypass       = valueOf (bypassParam) > 0.5f;
+    p.gainDb       = valueOf (gainParam);
+    p.detectorMode = (int) valueOf (detectorModeParam);
+    p.scHpfOn      = valueOf (scHpfOnParam) > 0.5f;
+    p.scHpfFreq    = valueOf (scHpfFreqParam);
+    p.unlinkPct    = valueOf (unlinkParam);
+    p.thresholdDb  = valueOf (thresholdParam);
+    p.kneeDb       = valueOf (kneeParam);
+    p.makeupDb     = valueOf (makeupParam);
+    p.ratio        = ratioFromChoiceIndex ((int) valueOf (ratioParam));
+    p.attackMs     = valueOf (attackParam);
+    p.releaseMs    = valueOf (releaseParam);
+    p.lookaheadMs  = valueOf (lookaheadParam);
+    p.linkMode          = (int) valueOf (linkModeParam);
+    p.scSource          = (int) valueOf (scSourceParam);
+    p.extHpfOn          = valueOf (extHpfOnParam) > 0.5f;
+    p.extHpfFreq        = valueOf (extHpfFreqParam);
+
+    p.mbMode = (int) valueOf (mbModeParam);
+    if (p.mbMode > 0) // the band parameters only matter when multiband is on
+    {
+        for (int i = 0; i < 3; ++i)
+            p.xover[i] = valueOf (xoverParam[i]);
 
-auto computeGainReductionDb = [&] (float inLevelDb)
+        for (int b = 0; b < MultibandCompressor::maxBands; ++b)
+        {
+            auto& band = p.bands[b];
+            band.thresholdDb = valueOf (bandThresholdParam[b]);
+            band.ratio       = ratioFromChoiceIndex ((int) valueOf (bandRatioParam[b]));
+            band.attackMs    = valueOf (bandAttackParam[b]);
+            band.releaseMs   = valueOf (bandReleaseParam[b]);
+            band.kneeDb      = valueOf (bandKneeParam[b]);
+        }
+    }
+    return p;
+}
+
+StereoCompressorBuild1AudioProcessor::ParamSnapshot StereoCompressorBuild1AudioProcessor::readParameters() const noexcept
 {
-    const float x = inLevelDb;
-    const float T = thresholdDb;
-    const float R = ratio;
+    return makeSnapshot ([] (const std::atomic<float>* param) { return param->load(); });
+}
 
-    if (kneeDb <= 0.0f)
+// Audio thread. Either the pending preset's snapshot, or the atomics read while no recall was writing them.
+// A retry finds the snapshot (it's published before the count goes odd and withdrawn after it's even
+// again) or reads atomics that are complete, so it only loops again if a whole recall fits into one read.
+StereoCompressorBuild1AudioProcessor::ParamSnapshot StereoCompressorBuild1AudioProcessor::readParametersOrPreset() noexcept
+{
+    for (;;)
     {
-        if (x <= T) return 0.0f;
-        const float y = T + (x - T) / R;
-        return (y - x);
+        const uint32_t before = presetWriteSequence.load (std::memory_order_seq_cst);
+
+        if (const auto* preset = pendingPreset.acquire())
+        {
+            const ParamSnapshot p = *preset;
+            pendingPreset.release();
+            return p;
+        }
+        pendingPreset.release();
+
+        const ParamSnapshot p = readParameters();
+
+        if ((before & 1) == 0 && presetWriteSequence.load (std::memory_order_seq_cst) == before)
+            return p;
     }
+}
+
+// The core's coefficient updates are driven by change: std::exp / pow only run when their inputs moved.
+// Oversampling isn't in here: that re-prepares the core, so it's applied off the audio thread
+// (applyOversamplingChange) and the audio keeps the current factor until then.
+void StereoCompressorBuild1AudioProcessor::updateCoefficients (const ParamSnapshot& p) noexcept
+{
+    if (p.linkMode != linkModeIndex)
+        updateLinkGroups (p.linkMode);
 
-    const float halfK = 0.5f * kneeDb;
+    CompressorCore::Parameters coreParams = p;
+    coreParams.externalKey = p.scSource == 1 && sidechainChannels > 0;
 
-    if (x < (T - halfK)) return 0.0f;
+    const int lookahead = core.getLookaheadSamples();
+    core.setParameters (coreParams);
 
-    if (x > (T + halfK))
+    if (core.getLookaheadSamples() != lookahead)
+        updateLatency();
+}
+
+// Lookahead (counted at the processing rate) + oversampling filters, in host samples. Can run on the audio
+// thread (a lookahead change), so it only stores the value; reportLatency tells the host.
+void StereoCompressorBuild1AudioProcessor::updateLatency()
+{
+    double latency = (double) core.getLookaheadSamples() / oversamplingFactor;
+    if (floatPath.activeOversampler != nullptr)
+        latency += (double) floatPath.activeOversampler->getLatencyInSamples();
+    else if (doublePath.activeOversampler != nullptr)
+        latency += (double) doublePath.activeOversampler->getLatencyInSamples();
+
+    reportedLatencySamples.store ((int) std::lround (latency));
+}
+
+// Not the audio thread: prepareToPlay and the timer. setLatencySamples notifies the host (delay compensation).
+void StereoCompressorBuild1AudioProcessor::reportLatency()
+{
+    const int samples = reportedLatencySamples.load();
+    if (samples != getLatencySamples())
+        setLatencySamples (samples);
+}
+
+// What still comes out after the input stops: the delayed audio (lookahead, oversampling filters) plus the
+// filters' ringing, the same allowance the idle path waits for. The followers' release isn't in it: with
+// no input it's gain on silence, not audio, and counting it down to the idle level made the tail seconds
+// long at slow release settings (about 11.5 s at 1000 ms peak, 23 s RMS), keeping hosts from suspending us.
+// If a host does suspend before the followers have settled, the held gain reduction releases normally on
+// the next block - as if the input had come back right after the tail. The idle path checks the
+// followers itself (core.isSettled) and doesn't depend on this.
+double StereoCompressorBuild1AudioProcessor::getTailLengthSeconds() const
+{
+    if (currentSampleRate <= 0.0)
+        return 0.0;
+
+    return reportedLatencySamples.load() / currentSampleRate + idleFlushSeconds;
+}
+
+void StereoCompressorBuild1AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& )
+{
+    processBlockImpl (buffer);
+}
+
+void StereoCompressorBuild1AudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& )
+{
+    processBlockImpl (buffer);
+}
+
+template <typename Sample>
+void StereoCompressorBuild1AudioProcessor::processBlockImpl (juce::AudioBuffer<Sample>& buffer) STEREOCOMP_NONBLOCKING
+{
+   #if STEREOCOMP_RT_TRAPS
+    const RealtimeTraps::ScopedRealtimeContext realtimeContext; // allocations from here on are trapped
+   #endif
+   #if STEREOCOMP_INSTRUMENTATION
+    const auto startNs = AudioThreadMonitor::now();
+   #endif
+
+    const int numChannels = numProcessChannels;
+    if (buffer.getNumChannels() < numChannels) return;
+    if (maxChunkSize == 0) return; // prepareToPlay hasn't run yet
+    if (isUsingDoublePrecision() != std::is_same_v<Sample, double>) return; // prepared for the other precision
+
+    auto& path = getAudioPath<Sample>();
+
+    juce::ScopedNoDenormals noDenormals;
+    // Clear any output channels that don't have input data
+auto totalNumInputChannels  = getTotalNumInputChannels();
+auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+    buffer.clear (i, 0, buffer.getNumSamples());
+
+//PARAMETER READS (one atomic load each, through the pointers cached in the constructor)
+    // ...unless a preset is being applied, in which case the whole new set comes in one piece
+    const ParamSnapshot params = readParametersOrPreset();
+
+    updateCoefficients (params); // only recomputes what actually changed
+
+    // the core only uses the table if it's for these exact curve parameters (the message thread may not have built it yet)
+    const auto* curve = gainCurve.acquire();
+    if (! useCurveTable)
+        curve = nullptr;
+
+    // external key: point straight into the host buffer (mono keys feed every channel)
+    const Sample* keyChannels[maxChannels] {};
+    const Sample* keyBlock[maxChannels] {};
+    const Sample* const* key = nullptr;
+    if (params.scSource == 1 && sidechainChannels > 0)
     {
-        const float y = T + (x - T) / R;
-        return (y - x);
+        const auto sidechain = getBusBuffer (buffer, true, 1);
+        if (sidechain.getNumChannels() > 0)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                keyBlock[ch] = sidechain.getReadPointer (ch % sidechain.getNumChannels());
+            key = keyChannels;
+        }
     }
 
-    const float d = x - (T - halfK);
-    const float y = x + (1.0f / R - 1.0f) * (d * d) / (2.0f * kneeDb);
-    return (y - x);
-};
+    auto bus = juce::dsp::AudioBlock<Sample> (buffer).getSubsetChannelBlock (0, (size_t) numChannels);
+    Sample* channels[maxChannels] {};
 
+    for (int start = 0; start < buffer.getNumSamples(); start += maxChunkSize)
+    {
+        const int numSamples = juce::jmin (maxChunkSize, buffer.getNumSamples() - start);
+        auto chunk = bus.getSubBlock ((size_t) start, (size_t) numSamples);
 
-// Process every sample    
+        const Sample* chunkChannels[maxChannels] {};
+        for (int ch = 0; ch < numChannels; ++ch)
+            chunkChannels[ch] = chunk.getChannelPointer ((size_t) ch);
+        loudnessAnalyser.capture (LoudnessAnalyser::input, chunkChannels, numSamples);
 
-auto* xL = buffer.getWritePointer (0);
-auto* xR = buffer.getWritePointer (1); //We need separate pointers for left and right channels
+        if (key != nullptr)
+            for (int ch = 0; ch < numChannels; ++ch)
+                keyChannels[ch] = keyBlock[ch] + start;
 
-    for (int n = 0; n < buffer.getNumSamples(); ++n)
-    {
-    float sL = xL[n] * inputGain;
-    float sR = xR[n] * inputGain; //sL and sR represent the audio signals we'll compress and we want them aligned in time
-    
+        // Idle fast path: only once the silence has flushed the delay lines and the detectors have decayed
+        bool silent = true;
+        for (int ch = 0; ch < numChannels && silent; ++ch)
+        {
+            const auto range = juce::FloatVectorOperations::findMinAndMax (chunk.getChannelPointer ((size_t) ch), numSamples);
+            silent = juce::jmax (-range.getStart(), range.getEnd()) < (Sample) idleInputLevel;
+
+            if (silent && key != nullptr)
+            {
+                const auto keyRange = juce::FloatVectorOperations::findMinAndMax (keyChannels[ch], numSamples);
+                silent = juce::jmax (-keyRange.getStart(), keyRange.getEnd()) < (Sample) idleInputLevel;
+            }
+        }
 
-    float detInL = sL;
-    float detInR = sR;
+        if (! silent)
+        {
+            idle = false;
+            silentSamples = 0;
+        }
+        else if (! idle)
+        {
+            const int flushSamples = reportedLatencySamples.load (std::memory_order_relaxed)
+                                   + (int) std::lround (idleFlushSeconds * currentSampleRate);
+            idle = silentSamples >= flushSamples && core.isSettled (idleStateLevel);
+            silentSamples = juce::jmin (silentSamples + numSamples, 1 << 30);
+        }
 
-    if (scHpfOn)
-       { detInL = scHpfL.processSample (detInL);
-         detInR = scHpfR.processSample (detInR);
-       }
+        totalBlocks.store (totalBlocks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
-    float detL = 0.0f;
-    float detR = 0.0f;
+        if (idle)
+        {
+            chunk.clear(); // below the floor: silence, not the (undelayed) input
+            core.skip (numSamples * oversamplingFactor);
+            accumulateMeters (chunk, nullptr, nullptr); // the meters still fall back
+            loudnessAnalyser.capture (LoudnessAnalyser::output, chunkChannels, numSamples);
+            skippedBlocks.store (skippedBlocks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            continue;
+        }
 
-    if (detectorMode == 0) // Peak
+        if (path.activeOversampler != nullptr)
         {
-        detL = envL.processSample (detInL);
-        detR = envR.processSample (detInR);
+            auto up = path.activeOversampler->processSamplesUp (chunk);
+            for (int ch = 0; ch < numChannels; ++ch)
+                channels[ch] = up.getChannelPointer ((size_t) ch);
+            core.process (channels, (int) up.getNumSamples(), key, oversamplingIndex, curve); // key held for 1 << index samples
+            path.activeOversampler->processSamplesDown (chunk);
         }
-     else // RMS
+        else
         {
-        detL = rmsL.processSample (detInL);
-        detR = rmsR.processSample (detInR);
+            for (int ch = 0; ch < numChannels; ++ch)
+                channels[ch] = chunk.getChannelPointer ((size_t) ch);
+            core.process (channels, numSamples, key, 0, curve);
         }
-    const float linkedDet = juce::jmax (detL, detR); // “max link” behavior
-    const float detUsedL = detL * unlink + linkedDet * link;
-    const float detUsedR = detR * unlink + linkedDet * link;
 
-    const float detDbL = juce::Decibels::gainToDecibels (detUsedL + eps);
-    const float detDbR = juce::Decibels::gainToDecibels (detUsedR + eps);
+        accumulateMeters (chunk, core.getMinGain(), core.getMaxDetector());
+        loudnessAnalyser.capture (LoudnessAnalyser::output, chunkChannels, numSamples);
+    }
 
-    const float grDbL  = computeGainReductionDb (detDbL);
-    const float grDbR  = computeGainReductionDb (detDbR);
+    gainCurve.release();
 
-    const float grLinL = juce::Decibels::decibelsToGain (grDbL);
-    const float grLinR = juce::Decibels::decibelsToGain (grDbR);
+   #if STEREOCOMP_INSTRUMENTATION
+    audioThreadMonitor.recordBlock (startNs, buffer.getNumSamples());
+    for (int ch = 0; ch < numChannels; ++ch) // after the timing, so the scan isn't part of it
+        audioThreadMonitor.checkOutput (buffer.getReadPointer (ch), buffer.getNumSamples());
+   #endif
+}
 
-    maxGRDbL = juce::jmax (maxGRDbL, -grDbL);
-    maxGRDbR = juce::jmax (maxGRDbR, -grDbR);
+// Folds one chunk (already back at the host rate) into the pending meter frame and pushes the frame
+// once it covers meterIntervalSamples. Ballistics are the editor's job; this only keeps the extremes.
+// minGain / maxDetector: the core's per-channel values for the chunk, nullptr when it didn't run (idle).
+template <typename Sample>
+void StereoCompressorBuild1AudioProcessor::accumulateMeters (const juce::dsp::AudioBlock<Sample>& output,
+                                                             const float* minGain, const float* maxDetector) noexcept
+{
+    const int numSamples = (int) output.getNumSamples();
 
-    xL[n] = sL * grLinL * makeupGain;
-    xR[n] = sR * grLinR * makeupGain;
+    for (int side = 0; side < 2; ++side)
+    {
+        const int ch = juce::jmin (side, numProcessChannels - 1);
+        const auto range = juce::FloatVectorOperations::findMinAndMax (output.getChannelPointer ((size_t) ch), numSamples);
 
+        if (minGain != nullptr)
+        {
+            pendingMinGain[side]     = juce::jmin (pendingMinGain[side], minGain[ch]);
+            pendingMaxDetector[side] = juce::jmax (pendingMaxDetector[side], maxDetector[ch]);
+        }
+        pendingPeak[side] = juce::jmax (pendingPeak[side], (float) -range.getStart(), (float) range.getEnd());
     }
 
-// --- Meter ballistics (fast attack, slow release) ---
-constexpr float meterRelease = 0.90f; // closer to 1 = slower decay
+    pendingMeterSamples += numSamples;
+    if (pendingMeterSamples < meterIntervalSamples)
+        return;
 
-grMeterL = juce::jmax(maxGRDbL, grMeterL * meterRelease);
-grMeterR = juce::jmax(maxGRDbR, grMeterR * meterRelease);
+    MeterFrame frame;
+    for (int side = 0; side < 2; ++side)
+    {
+        frame.detectorDb[side]      = juce::Decibels::gainToDecibels (pendingMaxDetector[side]);
+        frame.gainReductionDb[side] = -juce::Decibels::gainToDecibels (pendingMinGain[side]);
+        frame.outputPeakDb[side]    = juce::Decibels::gainToDecibels (pendingPeak[side]);
 
+        pendingMinGain[side] = 1.0f;
+        pendingMaxDetector[side] = 0.0f;
+        pendingPeak[side] = 0.0f;
+    }
+    frame.numSamples = (uint32_t) pendingMeterSamples;
+    pendingMeterSamples = 0;
+
+    meterRing.push (frame); // never waits: if the editor is closed or stalled the frame is dropped
 }
+
 //THIS IS THE END OF THE PROCESS BLOCK
 
 
@@ -250,16 +799,191 @@ juce::AudioProcessorEditor* StereoCompressorBuild1AudioProcessor::createEditor()
     return new StereoCompressorBuild1AudioProcessorEditor (*this); //Creates a generic editor that automatically generates UI based on parameters   
 } //JUCE builds a UI automatically from parameter layout.
 
-//Serializing parameter tree to XML and hands it to the DAW for saving
+// ---- State ----
+
+StereoCompressorBuild1AudioProcessor::ParameterValues StereoCompressorBuild1AudioProcessor::captureValues() const
+{
+    ParameterValues values;
+    values.reserve (stateParameters.size());
+    for (const auto& p : stateParameters)
+        values.push_back (p.value->load());
+    return values;
+}
+
+StereoCompressorBuild1AudioProcessor::ParameterValues StereoCompressorBuild1AudioProcessor::defaultValues() const
+{
+    ParameterValues values;
+    values.reserve (stateParameters.size());
+    for (const auto& p : stateParameters)
+        values.push_back (p.parameter->convertFrom0to1 (p.parameter->getDefaultValue()));
+    return values;
+}
+
+// Publishes the complete new snapshot first, then sets the parameters (host, editor and the atomics)
+// inside the presetWriteSequence seqlock, then withdraws the snapshot: the audio thread sees the old set
+// or the new one, never a mix (see readParametersOrPreset). Any thread but the audio thread: presetLock
+// makes it one writer at a time.
+void StereoCompressorBuild1AudioProcessor::applyValues (const ParameterValues& values)
+{
+    jassert (values.size() == stateParameters.size());
+    const juce::ScopedLock lock (presetLock);
+
+    // what each atomic will hold once the parameter has snapped the value to its range / steps
+    ParameterValues normalised (values.size()), plain (values.size());
+    for (size_t i = 0; i < stateParameters.size(); ++i)
+    {
+        const auto* param = stateParameters[i].parameter;
+        normalised[i] = param->convertTo0to1 (values[i]);
+        plain[i] = param->convertFrom0to1 (normalised[i]);
+    }
+
+    pendingPreset.publish (std::make_unique<ParamSnapshot> (makeSnapshot ([this, &plain] (const std::atomic<float>* param)
+    {
+        for (size_t i = 0; i < stateParameters.size(); ++i)
+            if (stateParameters[i].value == param)
+                return plain[i];
+        jassertfalse; // every parameter the snapshot reads is in stateParameters
+        return param->load();
+    })));
+
+    presetWriteSequence.fetch_add (1, std::memory_order_seq_cst); // odd: the atomics are a mix from here
+
+    for (size_t i = 0; i < stateParameters.size(); ++i)
+        if (stateParameters[i].parameter->getValue() != normalised[i])
+            stateParameters[i].parameter->setValueNotifyingHost (normalised[i]);
+
+    presetWriteSequence.fetch_add (1, std::memory_order_seq_cst);
+    pendingPreset.publish (nullptr); // the atomics are all current now
+}
+
+void StereoCompressorBuild1AudioProcessor::storePreset (int slot)
+{
+    const juce::ScopedLock lock (presetLock);
+    presetSlots[slot & 1] = captureValues();
+}
+
+bool StereoCompressorBuild1AudioProcessor::recallPreset (int slot)
+{
+    const juce::ScopedLock lock (presetLock);
+    slot &= 1;
+    if (presetSlots[slot].empty())
+        return false;
+
+    applyValues (presetSlots[slot]);
+    activePresetSlot = slot;
+    return true;
+}
+
+void StereoCompressorBuild1AudioProcessor::selectPresetSlot (int slot)
+{
+    const juce::ScopedLock lock (presetLock);
+    slot &= 1;
+    if (slot == activePresetSlot)
+        return;
+
+    storePreset (activePresetSlot);
+    if (! recallPreset (slot))
+    {
+        storePreset (slot); // first visit: the other slot starts as a copy
+        activePresetSlot = slot;
+    }
+}
+
+//Serializing parameters to the binary chunk above and handing it to the DAW for saving
 void StereoCompressorBuild1AudioProcessor::getStateInformation (juce::MemoryBlock& destData)
- {   auto state = apvts.copyState(); 
-    if (auto xml = state.createXml())
-        copyXmlToBinary (*xml, destData); //Saves the APVTS state to a binary block for the host to store
-}
-    void StereoCompressorBuild1AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
-{ 
-        if (auto xml = getXmlFromBinary(data, sizeInBytes))
-            apvts.replaceState (juce::ValueTree::fromXml(*xml)); //Restores the APVTS state from the host
+{
+    const juce::ScopedLock lock (presetLock); // the slots, against a recall on another thread
+    juce::MemoryOutputStream out (destData, false);
+    out.writeInt (stateMagic);
+    out.writeByte ((char) stateVersion);
+    out.writeByte ((char) activePresetSlot);
+
+    auto writeSection = [&] (const ParameterValues& values)
+    {
+        out.writeShort ((short) values.size());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            out.writeInt ((int) stateParameters[i].idHash);
+            out.writeFloat (values[i]);
+        }
+    };
+
+    writeSection (captureValues());
+    writeSection (presetSlots[0]);
+    writeSection (presetSlots[1]);
+}
+
+void StereoCompressorBuild1AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes < 6)
+        return;
+
+    if (juce::ByteOrder::littleEndianInt (data) == (juce::uint32) stateMagic)
+    {
+        juce::MemoryInputStream in (data, (size_t) sizeInBytes, false);
+        in.readInt();
+        if ((uint8_t) in.readByte() > stateVersion)
+        {
+            jassertfalse; // written by a newer version
+            return;
+        }
+        const int slot = in.readByte() & 1;
+
+        bool truncated = false;
+        auto readSection = [&] (bool emptyIfNone)
+        {
+            const int count = (uint16_t) in.readShort();
+            if (count == 0 && emptyIfNone)
+                return ParameterValues();
+
+            if (in.getNumBytesRemaining() < (juce::int64) count * 8)
+            {
+                truncated = true;
+                return ParameterValues();
+            }
+
+            auto values = defaultValues();
+            for (int e = 0; e < count; ++e)
+            {
+                const auto hash = (uint32_t) in.readInt();
+                const float value = in.readFloat();
+                for (size_t i = 0; i < stateParameters.size(); ++i)
+                    if (stateParameters[i].idHash == hash)
+                        values[i] = value;
+            }
+            return values;
+        };
+
+        auto current = readSection (false);
+        auto slotA = readSection (true);
+        auto slotB = readSection (true);
+        if (truncated)
+            return; // leave everything as it was rather than apply part of a chunk
+
+        const juce::ScopedLock lock (presetLock); // hosts call this from any thread, the A/B buttons run on the message thread
+        presetSlots[0] = std::move (slotA);
+        presetSlots[1] = std::move (slotB);
+        activePresetSlot = slot;
+        applyValues (current);
+        return;
+    }
+
+    // Sessions saved before the binary chunk: the APVTS tree as XML
+    if (auto xml = getXmlFromBinary (data, sizeInBytes))
+    {
+        if (! xml->hasTagName (apvts.state.getType()))
+            return;
+
+        auto values = defaultValues();
+        for (auto* param : xml->getChildWithTagNameIterator ("PARAM"))
+        {
+            const auto id = param->getStringAttribute ("id");
+            for (size_t i = 0; i < stateParameters.size(); ++i)
+                if (stateParameters[i].parameter->getParameterID() == id)
+                    values[i] = (float) param->getDoubleAttribute ("value", values[i]);
+        }
+        applyValues (values);
+    }
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
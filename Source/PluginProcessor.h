@@ -3,22 +3,76 @@
 #pragma once 
 #include <JuceHeader.h>
 #include <cmath>
+#include "CompressorCore.h"
+#include "Telemetry.h"
+#include "LoudnessAnalyser.h"
+#include "Publisher.h"
+#include "Instrumentation.h"
 
 
-class StereoCompressorBuild1AudioProcessor  : public juce::AudioProcessor
+class StereoCompressorBuild1AudioProcessor  : public juce::AudioProcessor,
+                                              private juce::Timer
 {
 public:
     StereoCompressorBuild1AudioProcessor();
-    ~StereoCompressorBuild1AudioProcessor() override = default;
-
-    float getLastGainReductionL() const noexcept { return lastGRL.load(); } //public getter for left gain reduction meter
-    float getLastGainReductionR() const noexcept { return lastGRR.load(); } //public getter for right gain reduction meter
+    ~StereoCompressorBuild1AudioProcessor() override;
+
+    // Gain-curve table for the current threshold / ratio / knee, shared by the DSP and the editor's
+    // transfer display. Message thread only (that's the thread that rebuilds and frees tables).
+    const GainCurveTable* getGainCurve() const noexcept { return gainCurve.getCurrent(); }
+    void updateGainCurve(); // rebuilds if the parameters moved; the timer calls it, tools can call it directly
+
+    // Metering: the audio thread pushes a frame every ~2 ms of audio, the editor pops them on its timer.
+    // Single consumer, so only the (one) open editor may call these.
+    bool popMeterFrame (MeterFrame& frame) noexcept { return meterRing.pop (frame); }
+    void discardMeterFrames() noexcept { meterRing.discardAll(); }
+
+    // BS.1770 loudness / true peak of the input and output, from the analysis thread (LoudnessAnalyser.h).
+    // Restarts with every prepareToPlay. Any thread but the audio thread.
+    LoudnessAnalyser& getLoudnessAnalyser() noexcept { return loudnessAnalyser; }
+
+    // Which of the DSP core's fast paths processBlock uses. All on is what the plugin runs; all off is the
+    // reference the regression tool checks them against (general loops, exact log10 / pow gain curve, no
+    // table). Between processBlock calls only, never while the audio thread is running.
+    struct DspPaths
+    {
+        bool specialisedLoops = true; // CompressorCore::setSpecialisedLoops
+        bool stereoPairLoop = true;   // CompressorCore::setStereoPairLoop
+        bool simdGainCurve = true;    // off = CompressorCore::setReferenceGainCurve
+        bool curveTable = true;       // the GainCurveTable when it's current (needs simdGainCurve)
+    };
+    void setDspPaths (const DspPaths&) noexcept;
+
+    // After prepareToPlay: whether the core's stereo pair detector loop is what a broadband block runs
+    bool isUsingStereoPairLoop() const noexcept { return core.isUsingStereoPairLoop(); }
+
+    // A/B preset slots, any thread but the audio thread (presetLock). A recall hands the audio thread the
+    // complete parameter set at once (see pendingPreset), so it never runs with half a preset applied and
+    // never waits.
+    void selectPresetSlot (int slot); // A/B compare: the current settings go into the active slot, then slot is recalled
+    void storePreset (int slot);
+    bool recallPreset (int slot);     // false if nothing was stored there
+    bool hasPreset (int slot) const noexcept { return ! presetSlots[slot & 1].empty(); }
+    int getActivePresetSlot() const noexcept { return activePresetSlot; }
+
+    // Idle fast path: chunks skipped because the input was silent and the detectors had settled, out of
+    // all chunks processed (one per host block unless the host goes over the prepared size). Any thread.
+    juce::uint64 getNumSkippedBlocks() const noexcept { return skippedBlocks.load (std::memory_order_relaxed); }
+    juce::uint64 getNumBlocks() const noexcept        { return totalBlocks.load (std::memory_order_relaxed); }
+
+   #if STEREOCOMP_INSTRUMENTATION
+    // processBlock timing / deadline / output checks since prepareToPlay (Instrumentation.h). Any thread.
+    AudioThreadMonitor::Stats getAudioThreadStats() const noexcept { return audioThreadMonitor.getStats(); }
+    void setDeadlineFraction (double fraction) noexcept { audioThreadMonitor.setDeadlineFraction (fraction); }
+   #endif
 
 //Plugin is a C++ class that inherits from JUCE's AudioProcessor class. This declares a contructor (runs when plugin loads) and destructor.
 
     void prepareToPlay (double sampleRate, int samplesPerBlock) override; //called once before audio starts; set sample rate; allocate buffers
-    void releaseResources() override{} //called when audio stops. leaving it empty for now
+    void releaseResources() override { loudnessAnalyser.release(); } //called when audio stops; the last loudness readings stay
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override; //called repeatedly, this is where DSP happens.
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override; //same DSP for hosts with a 64-bit mix engine
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override; //specifies which channel configurations are supported
 
@@ -31,7 +85,7 @@ public:
     bool acceptsMidi() const override{return false;} //indicates whether the plugin accepts MIDI input
     bool producesMidi() const override{return false;} //indicates whether the plugin produces MIDI output
     bool isMidiEffect() const override{return false;} //indicates whether the plugin is a MIDI effect
-    double getTailLengthSeconds() const override{return 0.0;} //returns the tail length in seconds 
+    double getTailLengthSeconds() const override; //latency + filter ringing still coming out after the input stops
 
     int getNumPrograms() override{return 1;} //returns the number of preset programs
     int getCurrentProgram() override{return 0;} //returns the index of the current program
@@ -55,122 +109,187 @@ private:
     // ---- Envelope follower (Day 3) ----
     double currentSampleRate = 44100.0;
 
-    std::atomic<float> lastEnvL { 0.0f };
-    std::atomic<float> lastEnvR { 0.0f };
+static constexpr int maxChannels = CompressorCore::maxChannels;
 
-struct OnePoleHPF
-{
-    void prepare (double sampleRate)
-    {
-        sr = sampleRate;
-        reset();
-        setCutoff (80.0f); //default cutoff frequency
-    }
-    void reset()
-    {
-        x1 = 0.0f;
-        y1 = 0.0f;   
-    }
-    void setCutoff (float hz)
-    {
-        hz = juce::jlimit (1.0f, 20000.0f, hz);
-        const float w = 2.0f * juce::MathConstants<float>::pi * hz / (float) sr;
-        const float x = std::exp (-w);
+// Detector, linking, lookahead, gain curve and gain (CompressorCore.h, no JUCE). This class is the
+// adapter around it: parameters, bus layout, oversampling, sidechain bus, idle path and metering.
+CompressorCore core;
 
-        a1 = x;
-        b0 = (1.0f + x) * 0.5f;
-        b1 = -b0;   
-    }
-    float processSample (float x0)
+// ---- Channel linking ----
+// Channels in the same group share the group's max detector level (blended in by "unlink").
+// Which channels share a group depends on the "linkMode" parameter and the bus layout.
+void updateLinkGroups (int linkMode);
+
+int numProcessChannels = 2;
+juce::AudioChannelSet::ChannelType channelTypes[maxChannels] {};
+int linkGroup[maxChannels] {};
+int numLinkGroups = 1;
+int linkModeIndex = -1;
+
+// Static curve tables, built on the message thread; the core falls back to its GainComputer for the
+// blocks between a parameter change and the new table being published.
+GainCurvePublisher gainCurve;
+bool useCurveTable = true; // DspPaths::curveTable
+void timerCallback() override
+{
+    updateGainCurve();
     {
-        const float y0 = b0 * x0 + b1 * x1 - a1 * y1;
-        x1 = x0;
-        y1 = y0;
-        return y0;
+        const juce::ScopedTryLock lock (presetLock); // a recall in progress on another thread: next tick
+        if (lock.isLocked())
+            pendingPreset.collectGarbage(); // a preset snapshot the audio thread was still reading when it was withdrawn
     }
-    double sr = 44100.0;
-    float a1 = 0.0f, b0 = 0.0f, b1 = 0.0f;
-    float x1 = 0.0f, y1 = 0.0f;
+    applyOversamplingChange();
+    reportLatency(); // a lookahead change the audio thread picked up
+}
+
+// ---- Parameters: atomics resolved once in the constructor ----
+std::atomic<float>* bypassParam       = nullptr;
+std::atomic<float>* gainParam         = nullptr;
+std::atomic<float>* detectorModeParam = nullptr;
+std::atomic<float>* scHpfOnParam      = nullptr;
+std::atomic<float>* scHpfFreqParam    = nullptr;
+std::atomic<float>* unlinkParam       = nullptr;
+std::atomic<float>* thresholdParam    = nullptr;
+std::atomic<float>* kneeParam         = nullptr;
+std::atomic<float>* makeupParam       = nullptr;
+std::atomic<float>* ratioParam        = nullptr;
+std::atomic<float>* attackParam       = nullptr;
+std::atomic<float>* releaseParam      = nullptr;
+std::atomic<float>* lookaheadParam    = nullptr;
+std::atomic<float>* oversamplingParam = nullptr;
+std::atomic<float>* osFilterParam     = nullptr;
+std::atomic<float>* linkModeParam     = nullptr;
+std::atomic<float>* scSourceParam     = nullptr;
+std::atomic<float>* extHpfOnParam     = nullptr;
+std::atomic<float>* extHpfFreqParam   = nullptr;
+std::atomic<float>* mbModeParam       = nullptr;
+std::atomic<float>* xoverParam[3] {};
+std::atomic<float>* bandThresholdParam[MultibandCompressor::maxBands] {};
+std::atomic<float>* bandRatioParam[MultibandCompressor::maxBands] {};
+std::atomic<float>* bandAttackParam[MultibandCompressor::maxBands] {};
+std::atomic<float>* bandReleaseParam[MultibandCompressor::maxBands] {};
+std::atomic<float>* bandKneeParam[MultibandCompressor::maxBands] {};
+
+// Everything processBlock needs, read once at the top of the block: the core's parameters plus the
+// ones the adapter handles itself (oversampling isn't one: the timer applies it, applyOversamplingChange)
+struct ParamSnapshot : CompressorCore::Parameters
+{
+    int linkMode = 0;          // 0 = all, 1 = all but LFE, 2 = fronts / surrounds
+    int scSource = 0;          // 0 = internal, 1 = external sidechain bus
 };
 
+ParamSnapshot readParameters() const noexcept;
+template <typename ValueOf> ParamSnapshot makeSnapshot (ValueOf&& valueOf) const noexcept; // valueOf (parameter atomic) -> plain value
+void updateCoefficients (const ParamSnapshot&) noexcept;
 
+// ---- State: every parameter, as a compact binary chunk (see getStateInformation) and as A/B preset slots ----
+struct StateParameter
+{
+    juce::RangedAudioParameter* parameter = nullptr;
+    std::atomic<float>* value = nullptr; // the APVTS plain value the audio thread reads
+    uint32_t idHash = 0;                 // what the binary chunk stores instead of the ID
+};
+std::vector<StateParameter> stateParameters; // getParameters() order
+
+using ParameterValues = std::vector<float>; // plain values, in stateParameters order
+ParameterValues captureValues() const;
+ParameterValues defaultValues() const;
+void applyValues (const ParameterValues&);
+
+ParameterValues presetSlots[2]; // empty = nothing stored
+int activePresetSlot = 0;
+
+// While applyValues sets the parameters one by one, the audio thread reads this complete snapshot
+// instead of the (partly updated) atomics; it's withdrawn once every atomic holds the new value.
+Publisher<ParamSnapshot> pendingPreset;
+
+// Seqlock around applyValues' atomic writes: odd while they're going on, bumped again when done. The audio
+// thread reads the atomics only if it sees the same even count before and after, so a recall that starts
+// between its (empty) snapshot check and its last load can't hand it half a preset.
+ParamSnapshot readParametersOrPreset() noexcept;
+std::atomic<uint32_t> presetWriteSequence { 0 };
+
+// The writer side of the two above, and the slots: setStateInformation comes on whatever thread the host
+// likes, the A/B buttons and the timer's collectGarbage on the message thread.
+juce::CriticalSection presetLock;
+
+// ---- Smoothing: the core ramps gain, makeup, threshold and unlink over this long ----
+static constexpr double minSmoothingSeconds = 0.02;
+double smoothingSeconds = minSmoothingSeconds; // at least one host block, so block-rate automation joins up
+
+// ---- Lookahead: audio delayed in the core, gain taken from the max of the detector over the delay window ----
+static constexpr float maxLookaheadMs = CompressorCore::maxLookaheadMs;
+void updateLatency();  // any thread: recomputes reportedLatencySamples
+void reportLatency();  // message thread: passes it on to the host
+
+std::atomic<int> reportedLatencySamples { 0 }; // what the DSP runs with; the host hears about it from reportLatency
+
+// ---- Oversampling: the core runs at 1x / 2x / 4x ----
+static constexpr int maxOversamplingFactor = 4;
+void setOversampling (int factorIndex, int filterIndex);
+void applyOversamplingChange();
+
+int oversamplingIndex = 0;
+int osFilterIndex = 0;
+int oversamplingFactor = 1;
+
+// ---- Idle: silent input (and key) + settled detector state -> the chunk's DSP is skipped and it outputs silence.
+// Entered only after the latency plus idleFlushSeconds of silence has gone through, so the delay lines and
+// oversampling filters hold nothing audible; left on the first chunk that isn't silent. ----
+static constexpr float idleInputLevel = 1.0e-5f;  // -100 dBFS peak over the chunk
+static constexpr float idleStateLevel = 1.0e-5f;  // followers (RMS: power below its square), HPFs, crossovers
+static constexpr double idleFlushSeconds = 0.01;  // filter tails on top of the reported latency
+
+int silentSamples = 0; // host samples of silent input processed in a row
+bool idle = false;
+std::atomic<juce::uint64> skippedBlocks { 0 };
+std::atomic<juce::uint64> totalBlocks { 0 };
+
+#if STEREOCOMP_INSTRUMENTATION
+AudioThreadMonitor audioThreadMonitor;
+#endif
+
+// ---- Precision: float and double share processBlockImpl; the core keeps the detector and gain curve
+// in float (they're control signals) and builds its delay lines for the precision in use. ----
+template <typename Sample>
+struct AudioPath
+{
+    std::unique_ptr<juce::dsp::Oversampling<Sample>> oversamplers[2][2]; // [IIR, FIR][2x, 4x], built in prepareToPlay for the bus width
+    juce::dsp::Oversampling<Sample>* activeOversampler = nullptr;        // nullptr at 1x
+};
 
-    // --- Gain Reduction meter smoothing (GUI only) ---
-float grMeterL = 0.0f;
-float grMeterR = 0.0f;
-
+AudioPath<float> floatPath;
+AudioPath<double> doublePath; // only built when the host asks for double precision
 
-    struct EnvelopeFollower
-    {
-        void prepare (double sampleRate)
-
-
-        {
-            sr = sampleRate;
-            env = 0.0f;
-            updateTimeConstants (10.0f, 100.0f);
-        }
-
-        void updateTimeConstants (float attackMs, float releaseMs)
-        {
-            attackCoeff  = std::exp (-1.0f / (0.001f * attackMs  * (float) sr));
-            releaseCoeff = std::exp (-1.0f / (0.001f * releaseMs * (float) sr));
-        }
-
-        float processSample (float x)
-        {
-            x = std::fabs (x); //floating absolute value
-            const float coeff = (x > env) ? attackCoeff : releaseCoeff;
-            env = x + coeff * (env - x);
-            return env;
-        }
-
-        float getEnvelope() const { return env; }
-
-        double sr = 44100.0;
-        float env = 0.0f;
-        float attackCoeff = 0.0f;
-        float releaseCoeff = 0.0f;
-    };
-    struct RMSFollower
+template <typename Sample>
+AudioPath<Sample>& getAudioPath() noexcept
 {
-        void prepare (double sampleRate)
-    {
-        sr = sampleRate;
-        envPower = 0.0f;
-        updateTimeConstants (10.0f, 100.0f);
-    }
+    if constexpr (std::is_same_v<Sample, double>) return doublePath;
+    else                                          return floatPath;
+}
 
-        void updateTimeConstants (float attackMs, float releaseMs)
-    {
-        attackCoeff  = std::exp (-1.0f / (0.001f * attackMs  * (float) sr));
-        releaseCoeff = std::exp (-1.0f / (0.001f * releaseMs * (float) sr));
-    }
+template <typename Sample> void prepareAudioPath (AudioPath<Sample>&);
+template <typename Sample> void processBlockImpl (juce::AudioBuffer<Sample>&) STEREOCOMP_NONBLOCKING;
 
-        float processSample (float x)
-    {
-        const float p = x * x; // power
-        const float coeff = (p > envPower) ? attackCoeff : releaseCoeff;
-        envPower = p + coeff * (envPower - p);
-        return std::sqrt (envPower);
-    }
-
-        double sr = 44100.0;
-        float envPower = 0.0f;
-        float attackCoeff = 0.0f;
-        float releaseCoeff = 0.0f;
-};
+// ---- External sidechain (optional second input bus) ----
+// The detector reads the key straight from the host buffer; nothing is copied. When oversampling,
+// each key sample is held for the oversampling factor (it only feeds the envelope, not the audio).
+int sidechainChannels = 0;     // 0 = bus disabled / not connected, set in prepareToPlay
 
+int maxChunkSize = 0;
 
-    EnvelopeFollower envL, envR;
-    RMSFollower rmsL, rmsR;
+// ---- Metering: L / R (channels 0 and 1) accumulated over a few chunks, then pushed to the editor ----
+template <typename Sample> void accumulateMeters (const juce::dsp::AudioBlock<Sample>& output, const float* minGain, const float* maxDetector) noexcept;
 
-// Sidechain (detector) HPF
-OnePoleHPF scHpfL, scHpfR;
+SpscRing<MeterFrame, 2048> meterRing; // ~4 s of frames, enough for the editor's scrolling trace
+int meterIntervalSamples = 96;        // ~2 ms at the host rate, set in prepareToPlay
+int pendingMeterSamples = 0;
+float pendingMinGain[2] = { 1.0f, 1.0f };
+float pendingMaxDetector[2] {};
+float pendingPeak[2] {};
 
-// Gain Reduction meter values (store POSITIVE dB, e.g. 0..24)
-std::atomic<float> lastGRL { 0.0f };
-std::atomic<float> lastGRR { 0.0f };
+// ---- Loudness: every chunk is copied into the analyser's rings before and after processing ----
+LoudnessAnalyser loudnessAnalyser;
 
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StereoCompressorBuild1AudioProcessor)
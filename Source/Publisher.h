@@ -0,0 +1,75 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Hands immutable objects from one writer thread (the message thread) to the audio thread.
+//
+// Reader: acquire() at the top of the block, release() when done with the object. No locks, no
+// allocation; the pointer it's using is published as a hazard pointer.
+// Writer: publish() swaps the new object in (nullptr is fine) and retires the old one, which is only
+// deleted once the reader's hazard pointer no longer names it (checked again on every publish /
+// collectGarbage()).
+template <typename T>
+class Publisher
+{
+public:
+    Publisher() = default;
+
+    ~Publisher()
+    {
+        delete current.load();
+        for (auto* t : retired)
+            delete t;
+    }
+
+    // writer thread
+    void publish (std::unique_ptr<T> object)
+    {
+        if (const T* old = current.exchange (object.release(), std::memory_order_seq_cst))
+            retired.push_back (old);
+
+        collectGarbage();
+    }
+
+    void collectGarbage()
+    {
+        const T* inUse = hazard.load (std::memory_order_seq_cst);
+
+        retired.erase (std::remove_if (retired.begin(), retired.end(), [inUse] (const T* t)
+                       {
+                           if (t == inUse)
+                               return false; // the audio thread may still be reading it
+                           delete t;
+                           return true;
+                       }),
+                       retired.end());
+    }
+
+    const T* getCurrent() const noexcept { return current.load (std::memory_order_acquire); }
+
+    // reader thread
+    const T* acquire() noexcept
+    {
+        const T* t = current.load (std::memory_order_acquire);
+        for (;;)
+        {
+            hazard.store (t, std::memory_order_seq_cst);
+            const T* again = current.load (std::memory_order_seq_cst);
+            if (again == t)
+                return t;
+            t = again; // swapped while we were announcing it; go again with the new one
+        }
+    }
+
+    void release() noexcept { hazard.store (nullptr, std::memory_order_release); }
+
+private:
+    std::atomic<const T*> current { nullptr };
+    std::atomic<const T*> hazard { nullptr };
+    std::vector<const T*> retired; // writer thread only
+
+    Publisher (const Publisher&) = delete;
+    Publisher& operator= (const Publisher&) = delete;
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Parameter ramps.
+//
+// Same arithmetic as juce::SmoothedValue<float> (Linear / Multiplicative), step for step, so the
+// ramps the processor ran before the DSP moved out of the plugin come out bit-identical:
+// a fixed number of steps per ramp (floor (seconds * rate)), a new target restarts the count,
+// and the last step lands exactly on the target.
+enum class RampShape { linear, multiplicative };
+
+template <RampShape shape>
+class ParameterRamp
+{
+public:
+    explicit ParameterRamp (float initialValue) noexcept : current (initialValue), target (initialValue) {}
+
+    void reset (double sampleRate, double rampSeconds) noexcept
+    {
+        stepsToTarget = (int) std::floor (rampSeconds * sampleRate);
+        setCurrentAndTargetValue (target);
+    }
+
+    void setCurrentAndTargetValue (float newValue) noexcept
+    {
+        current = target = newValue;
+        countdown = 0;
+    }
+
+    void setTargetValue (float newValue) noexcept
+    {
+        if (approximatelyEqual (newValue, target))
+            return;
+
+        if (stepsToTarget <= 0)
+        {
+            setCurrentAndTargetValue (newValue);
+            return;
+        }
+
+        target = newValue;
+        countdown = stepsToTarget;
+
+        if constexpr (shape == RampShape::linear)
+            step = (target - current) / (float) countdown;
+        else
+            step = std::exp ((std::log (std::abs (target)) - std::log (std::abs (current))) / (float) countdown);
+    }
+
+    bool isSmoothing() const noexcept { return countdown > 0; }
+    float getCurrentValue() const noexcept { return current; }
+    float getTargetValue() const noexcept { return target; }
+
+    float getNextValue() noexcept
+    {
+        if (! isSmoothing())
+            return target;
+
+        --countdown;
+
+        if (! isSmoothing())
+            current = target;
+        else if constexpr (shape == RampShape::linear)
+            current += step;
+        else
+            current *= step;
+
+        return current;
+    }
+
+    float skip (int numSamples) noexcept
+    {
+        if (numSamples >= countdown)
+        {
+            setCurrentAndTargetValue (target);
+            return target;
+        }
+
+        if constexpr (shape == RampShape::linear)
+            current += step * (float) numSamples;
+        else
+            current *= (float) std::pow (step, numSamples);
+
+        countdown -= numSamples;
+        return current;
+    }
+
+private:
+    // juce::approximatelyEqual's default tolerance
+    static bool approximatelyEqual (float a, float b) noexcept
+    {
+        if (! (std::isfinite (a) && std::isfinite (b)))
+            return a == b;
+
+        const float diff = std::abs (a - b);
+        return diff <= std::numeric_limits<float>::min()
+            || diff <= std::numeric_limits<float>::epsilon() * std::max (std::abs (a), std::abs (b));
+    }
+
+    float current, target;
+    float step = 0.0f;
+    int countdown = 0;
+    int stepsToTarget = 0;
+};
+
+using LinearRamp = ParameterRamp<RampShape::linear>;
+using MultiplicativeRamp = ParameterRamp<RampShape::multiplicative>;
@@ -0,0 +1,340 @@
+#include "StreamBatch.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include "Lanes.h"
+
+// same as juce::Decibels::decibelsToGain (-100 dB floor)
+static float decibelsToGain (float dB) noexcept
+{
+    return dB > -100.0f ? std::pow (10.0f, dB * 0.05f) : 0.0f;
+}
+
+StreamBatch::~StreamBatch()
+{
+    stopWorkers();
+}
+
+void StreamBatch::allocate (int streams, int maxBlockSize, int numThreads)
+{
+    stopWorkers();
+
+    numStreams = std::max (0, streams);
+    numGroups = (numStreams + streamsPerGroup - 1) / streamsPerGroup;
+    blockCapacity = std::max (1, maxBlockSize);
+
+    // no point in more threads than groups
+    const int threads = std::max (1, std::min (numThreads, numGroups));
+
+    groups.assign ((size_t) numGroups, GroupState {});
+    zeros.assign ((size_t) blockCapacity, 0.0f);
+    scratch.assign ((size_t) (threads * 2 * streamsPerGroup * blockCapacity), 0.0f);
+
+    quit = false;
+    generation = 0;
+    for (int t = 1; t < threads; ++t)
+        workers.emplace_back ([this, t] { workerLoop (t); });
+}
+
+void StreamBatch::setSampleRate (double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    reset();
+
+    // defaults until setParameters(), as DetectorBank::prepare
+    EnvelopeFollower<float> f;
+    f.sr = sampleRate;
+    f.updateTimeConstants (10.0f, 100.0f);
+    attackCoeff = f.attackCoeff;
+    releaseCoeff = f.releaseCoeff;
+
+    OnePoleHPF<float> h;
+    h.sr = sampleRate;
+    h.setCutoff (80.0f);
+    hpfB0 = h.b0;
+    hpfB1 = h.b1;
+    hpfA1 = h.a1;
+}
+
+void StreamBatch::setParameters (const CompressorCore::Parameters& p) noexcept
+{
+    EnvelopeFollower<float> f; // the core's coefficient formulas, by construction
+    f.sr = sampleRate;
+    f.updateTimeConstants (p.attackMs, p.releaseMs);
+    attackCoeff = f.attackCoeff;
+    releaseCoeff = f.releaseCoeff;
+
+    if (p.scHpfOn)
+    {
+        OnePoleHPF<float> h;
+        h.sr = sampleRate;
+        h.setCutoff (p.scHpfFreq);
+        hpfB0 = h.b0;
+        hpfB1 = h.b1;
+        hpfA1 = h.a1;
+    }
+
+    // the follower slot holds an envelope for one mode and a mean square for the other
+    const bool newRms = p.detectorMode != 0;
+    if (newRms != rms)
+        for (auto& g : groups)
+            std::fill (&g.follower[0][0], &g.follower[0][0] + 2 * streamsPerGroup, 0.0f);
+
+    bypass = p.bypass;
+    rms = newRms;
+    hpfOn = p.scHpfOn;
+    unlink = std::clamp (p.unlinkPct / 100.0f, 0.0f, 1.0f);
+    link = 1.0f - unlink;
+    inputGain = decibelsToGain (p.gainDb);
+    makeupGain = decibelsToGain (p.makeupDb);
+    gainComputer.setParameters (p.thresholdDb, p.ratio, p.kneeDb);
+}
+
+void StreamBatch::reset() noexcept
+{
+    std::fill (groups.begin(), groups.end(), GroupState {});
+}
+
+void StreamBatch::resetStream (int stream) noexcept
+{
+    if (stream < 0 || stream >= numStreams)
+        return;
+
+    auto& g = groups[(size_t) (stream / streamsPerGroup)];
+    const int lane = stream % streamsPerGroup;
+    for (int ch = 0; ch < 2; ++ch)
+        g.hpfX1[ch][lane] = g.hpfY1[ch][lane] = g.follower[ch][lane] = 0.0f;
+}
+
+//==============================================================================
+void StreamBatch::process (float* const* left, float* const* right, int numSamples)
+{
+    if (bypass || numGroups == 0 || numSamples <= 0)
+        return;
+
+    const Job thisJob { left, right, numSamples };
+
+    if (! workers.empty())
+    {
+        {
+            const std::lock_guard<std::mutex> lock (poolLock);
+            job = thisJob;
+            pending = (int) workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+    }
+
+    processGroups (0, thisJob);
+
+    if (! workers.empty())
+    {
+        std::unique_lock<std::mutex> lock (poolLock);
+        finished.wait (lock, [this] { return pending == 0; });
+    }
+}
+
+void StreamBatch::workerLoop (int thread)
+{
+    uint64_t done = 0;
+
+    for (;;)
+    {
+        Job j;
+        {
+            std::unique_lock<std::mutex> lock (poolLock);
+            wake.wait (lock, [this, done] { return quit || generation != done; });
+            if (quit)
+                return;
+            done = generation;
+            j = job;
+        }
+
+        processGroups (thread, j);
+
+        const std::lock_guard<std::mutex> lock (poolLock);
+        if (--pending == 0)
+            finished.notify_one();
+    }
+}
+
+void StreamBatch::stopWorkers()
+{
+    {
+        const std::lock_guard<std::mutex> lock (poolLock);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for (auto& w : workers)
+        w.join();
+    workers.clear();
+}
+
+// Thread t's contiguous share of the groups, a block at a time
+void StreamBatch::processGroups (int thread, const Job& j) noexcept
+{
+    const int numThreads = (int) workers.size() + 1;
+    const int first = (int) ((int64_t) numGroups * thread / numThreads);
+    const int last = (int) ((int64_t) numGroups * (thread + 1) / numThreads);
+
+    float* detL = scratch.data() + (size_t) thread * 2 * streamsPerGroup * blockCapacity;
+    float* detR = detL + streamsPerGroup * blockCapacity;
+
+    for (int group = first; group < last; ++group)
+    {
+        for (int start = 0; start < j.numSamples; start += blockCapacity)
+        {
+            const int numSamples = std::min (blockCapacity, j.numSamples - start);
+            float* left[streamsPerGroup] {};
+            float* right[streamsPerGroup] {};
+
+            for (int lane = 0; lane < streamsPerGroup; ++lane)
+            {
+                const int stream = group * streamsPerGroup + lane;
+                if (stream < numStreams)
+                {
+                    left[lane] = j.left[stream] + start;
+                    right[lane] = j.right[stream] + start;
+                }
+            }
+
+            processGroup (group, left, right, numSamples, detL, detR);
+        }
+    }
+}
+
+// One group, one block: detector for the four streams at once, then the gain curve over all of their
+// levels in one go, then each stream's gain. Unused lanes (left[lane] == nullptr) read silence.
+void StreamBatch::processGroup (int group, float* const* left, float* const* right, int numSamples, float* detL, float* detR) noexcept
+{
+    const float* inL[streamsPerGroup];
+    const float* inR[streamsPerGroup];
+    for (int lane = 0; lane < streamsPerGroup; ++lane)
+    {
+        inL[lane] = left[lane] != nullptr ? left[lane] : zeros.data();
+        inR[lane] = right[lane] != nullptr ? right[lane] : zeros.data();
+    }
+
+    auto& state = groups[(size_t) group];
+    const LinkShape shape = unlink == 0.0f ? LinkShape::linked
+                          : unlink == 1.0f ? LinkShape::unlinked
+                                           : LinkShape::blend;
+
+    auto run = [&] (auto hpf, auto isRms)
+    {
+        constexpr bool h = decltype (hpf)::value, r = decltype (isRms)::value;
+        switch (shape)
+        {
+            case LinkShape::linked:   detectorLoop<h, r, LinkShape::linked>   (state, inL, inR, detL, detR, numSamples); break;
+            case LinkShape::unlinked: detectorLoop<h, r, LinkShape::unlinked> (state, inL, inR, detL, detR, numSamples); break;
+            case LinkShape::blend:    detectorLoop<h, r, LinkShape::blend>    (state, inL, inR, detL, detR, numSamples); break;
+        }
+    };
+
+    if (hpfOn)
+    {
+        if (rms) run (std::true_type {}, std::true_type {});
+        else     run (std::true_type {}, std::false_type {});
+    }
+    else
+    {
+        if (rms) run (std::false_type {}, std::true_type {});
+        else     run (std::false_type {}, std::false_type {});
+    }
+
+    // detector level -> linear gain, [sample][lane] in place
+    gainComputer.process (detL, detL, streamsPerGroup * numSamples);
+    gainComputer.process (detR, detR, streamsPerGroup * numSamples);
+
+    // same multiply order as the core's applyGain
+    for (int lane = 0; lane < streamsPerGroup; ++lane)
+    {
+        if (left[lane] == nullptr)
+            continue;
+
+        float* l = left[lane];
+        float* r = right[lane];
+        for (int n = 0; n < numSamples; ++n)
+        {
+            l[n] = l[n] * inputGain * detL[streamsPerGroup * n + lane] * makeupGain;
+            r[n] = r[n] * inputGain * detR[streamsPerGroup * n + lane] * makeupGain;
+        }
+    }
+}
+
+// The core's detector per lane (CompressorCore::stereoDetectorLoop, with streams where that has channels):
+// HPF, follower, then the L / R max as std::max (std::max (0, L), R) and the link blend, in the same order.
+template <bool hpfOn, bool rms, StreamBatch::LinkShape linkShape>
+void StreamBatch::detectorLoop (GroupState& g, const float* const* left, const float* const* right,
+                                float* detL, float* detR, int numSamples) const noexcept
+{
+    const Lanes4 b0 = Lanes4::fill (hpfB0), b1 = Lanes4::fill (hpfB1), a1 = Lanes4::fill (hpfA1);
+    const Lanes4 attack = Lanes4::fill (attackCoeff), release = Lanes4::fill (releaseCoeff);
+    const Lanes4 gain = Lanes4::fill (inputGain);
+    const Lanes4 zero = Lanes4::fill (0.0f), u = Lanes4::fill (unlink), l = Lanes4::fill (link);
+
+    Lanes4 x1[2] = { Lanes4::load (g.hpfX1[0]), Lanes4::load (g.hpfX1[1]) };
+    Lanes4 y1[2] = { Lanes4::load (g.hpfY1[0]), Lanes4::load (g.hpfY1[1]) };
+    Lanes4 state[2] = { Lanes4::load (g.follower[0]), Lanes4::load (g.follower[1]) };
+
+    auto detect = [&] (int ch, Lanes4 in)
+    {
+        if constexpr (hpfOn)
+        {
+            const Lanes4 y0 = b0 * in + b1 * x1[ch] - a1 * y1[ch];
+            x1[ch] = in;
+            y1[ch] = y0;
+            in = y0;
+        }
+
+        if constexpr (! rms)
+        {
+            const Lanes4 a = Lanes4::abs (in);
+            state[ch] = a + Lanes4::selectGreater (a, state[ch], attack, release) * (state[ch] - a);
+            return state[ch];
+        }
+        else
+        {
+            const Lanes4 p = in * in;
+            state[ch] = p + Lanes4::selectGreater (p, state[ch], attack, release) * (state[ch] - p);
+            return Lanes4::sqrt (state[ch]);
+        }
+    };
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        const Lanes4 levelL = detect (0, Lanes4::set (left[0][n], left[1][n], left[2][n], left[3][n]) * gain);
+        const Lanes4 levelR = detect (1, Lanes4::set (right[0][n], right[1][n], right[2][n], right[3][n]) * gain);
+
+        Lanes4 outL = levelL, outR = levelR;
+        if constexpr (linkShape != LinkShape::unlinked)
+        {
+            const Lanes4 groupMax = Lanes4::max (levelR, Lanes4::max (levelL, zero));
+
+            if constexpr (linkShape == LinkShape::linked)
+            {
+                outL = outR = groupMax;
+            }
+            else
+            {
+                outL = levelL * u + groupMax * l;
+                outR = levelR * u + groupMax * l;
+            }
+        }
+
+        outL.store (detL + streamsPerGroup * n);
+        outR.store (detR + streamsPerGroup * n);
+    }
+
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        if constexpr (hpfOn)
+        {
+            x1[ch].store (g.hpfX1[ch]);
+            y1[ch].store (g.hpfY1[ch]);
+        }
+        state[ch].store (g.follower[ch]);
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CompressorCore.h"
+
+// Many independent stereo streams through one set of compressor settings, for offline / server-side
+// work (stems, a whole catalogue).
+//
+// A CompressorCore per stream would carry all of the core's per-instance state and scratch for each one.
+// Here a stream is just its detector state - sidechain HPF and peak / RMS follower for L and R, 24 bytes -
+// kept four streams to a group, structure-of-arrays inside the group (array-of-structures-of-arrays), so
+// one step of the detector runs four streams in the lanes of one Lanes4 register. The gain curve runs
+// over each group's detector levels with the same GainComputer kernel as the core.
+//
+//     StreamBatch batch;
+//     batch.allocate (numStreams, 4096, (int) std::thread::hardware_concurrency());
+//     batch.setSampleRate (48000.0);
+//     batch.setParameters (params);
+//     batch.process (left, right, numSamples); // left[s] / right[s]: stream s, in place
+//
+// Per stream it's the core's broadband path with the settings static: same follower, link and gain
+// arithmetic in the same order, so a stream comes out as a two-channel CompressorCore would leave it
+// once that core's ramps have settled. Not supported: lookahead, external key, multiband (those fields of
+// the Parameters are ignored), and nothing ramps - a setParameters() between calls steps.
+//
+// process() splits the groups over the threads allocate() started and waits for them (the calling
+// thread takes a share), so it's not for an audio thread; give it large blocks.
+class StreamBatch
+{
+public:
+    static constexpr int streamsPerGroup = 4; // one Lanes4 register
+
+    StreamBatch() = default;
+    ~StreamBatch();
+
+    // Allocation and thread creation happen here only. numThreads counts the calling thread (1 = no
+    // workers). Longer blocks are fine later, they're processed maxBlockSize at a time.
+    void allocate (int numStreams, int maxBlockSize, int numThreads = 1);
+
+    // Clears every stream's state; coefficients are recomputed on the next setParameters()
+    void setSampleRate (double sampleRate);
+
+    // The broadband fields of the core's Parameters (see above). Changing the detector mode clears the
+    // followers; the HPF keeps its cutoff while it's off, as in the core.
+    void setParameters (const CompressorCore::Parameters&) noexcept;
+
+    void reset() noexcept;                 // every stream, as after setSampleRate()
+    void resetStream (int stream) noexcept; // one slot, e.g. before it starts on the next file
+
+    // In place: left[s] / right[s] are stream s's channels, numSamples each, for every allocated stream
+    void process (float* const* left, float* const* right, int numSamples);
+
+    int getNumStreams() const noexcept { return numStreams; }
+    int getNumThreads() const noexcept { return (int) workers.size() + 1; }
+
+    // Per stream: sidechain HPF state and follower (peak envelope, or mean square for RMS), L and R
+    static constexpr int bytesPerStream = 6 * (int) sizeof (float);
+
+private:
+    // Four streams, lane s = stream s of the group
+    struct alignas (16) GroupState
+    {
+        float hpfX1[2][streamsPerGroup]; // [channel][lane]
+        float hpfY1[2][streamsPerGroup];
+        float follower[2][streamsPerGroup];
+    };
+    static_assert (sizeof (GroupState) == streamsPerGroup * bytesPerStream, "no padding between groups");
+
+    enum class LinkShape { linked, unlinked, blend };
+
+    struct Job
+    {
+        float* const* left = nullptr;
+        float* const* right = nullptr;
+        int numSamples = 0;
+    };
+
+    void processGroups (int thread, const Job&) noexcept;
+    void processGroup (int group, float* const* left, float* const* right, int numSamples, float* detL, float* detR) noexcept;
+
+    template <bool hpfOn, bool rms, LinkShape linkShape>
+    void detectorLoop (GroupState&, const float* const* left, const float* const* right, float* detL, float* detR, int numSamples) const noexcept;
+
+    void stopWorkers();
+    void workerLoop (int thread);
+
+    int numStreams = 0;
+    int numGroups = 0;
+    int blockCapacity = 0;
+    double sampleRate = 44100.0;
+
+    std::vector<GroupState> groups;
+    std::vector<float> zeros;   // input of a group's unused lanes
+    std::vector<float> scratch; // per thread: detector levels / gains of one group, [sample][lane] for L and R
+
+    // Current values, resolved by setParameters()
+    bool bypass = false;
+    bool rms = false;
+    bool hpfOn = false;
+    float unlink = 0.0f, link = 1.0f;
+    float inputGain = 1.0f, makeupGain = 1.0f;
+    float attackCoeff = 0.0f, releaseCoeff = 0.0f;
+    float hpfB0 = 0.0f, hpfB1 = 0.0f, hpfA1 = 0.0f;
+    GainComputer gainComputer;
+
+    // ---- Thread pool: worker t (1 .. numThreads - 1) takes the t-th share of the groups per process() ----
+    std::vector<std::thread> workers;
+    std::mutex poolLock;
+    std::condition_variable wake, finished;
+    Job job;
+    uint64_t generation = 0; // bumped per process() call
+    int pending = 0;         // workers still on the current job
+    bool quit = false;
+};
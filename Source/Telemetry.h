@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Audio thread -> GUI metering and analysis.
+//
+// The processor pushes a MeterFrame every few milliseconds of audio; the editor pops them on its
+// timer. One producer, one consumer, no locks and no allocation: push() and pop() are a couple of
+// loads and stores each, and a full ring just drops the new frame instead of waiting.
+// AudioCaptureRing does the same for blocks of samples (the loudness analyser's tap).
+
+struct MeterFrame
+{
+    float detectorDb[2] {};      // loudest detector level driving the curve, L / R
+    float gainReductionDb[2] {}; // positive dB, e.g. 0..24
+    float outputPeakDb[2] {};
+    uint32_t numSamples = 0;     // host samples this frame covers
+};
+
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert (Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer thread only. Returns false (and drops the item) when the consumer has fallen behind.
+    bool push (const T& item) noexcept
+    {
+        const size_t w = writeIndex.load (std::memory_order_relaxed);
+        if (w - readIndex.load (std::memory_order_acquire) == Capacity)
+        {
+            numDropped.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        items[w & (Capacity - 1)] = item;
+        writeIndex.store (w + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only.
+    bool pop (T& item) noexcept
+    {
+        const size_t r = readIndex.load (std::memory_order_relaxed);
+        if (r == writeIndex.load (std::memory_order_acquire))
+            return false;
+
+        item = items[r & (Capacity - 1)];
+        readIndex.store (r + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only: throw away whatever is queued (e.g. frames from before the editor opened).
+    void discardAll() noexcept
+    {
+        readIndex.store (writeIndex.load (std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t getNumDropped() const noexcept { return numDropped.load (std::memory_order_relaxed); }
+
+private:
+    T items[Capacity] {};
+
+    // separate cache lines, so the two threads don't keep stealing each other's line
+    alignas (64) std::atomic<size_t> writeIndex { 0 };
+    alignas (64) std::atomic<size_t> readIndex { 0 };
+    alignas (64) std::atomic<size_t> numDropped { 0 };
+};
+
+// Blocks of audio, planar, for a fixed number of channels. Same rules as SpscRing: one producer (the
+// audio thread), one consumer, and a block that doesn't fit is dropped whole (and counted) rather than
+// waited for or split. allocate() is the only call that allocates; neither side may be running then.
+class AudioCaptureRing
+{
+public:
+    // capacity rounds up to a power of two
+    void allocate (int channels, int minCapacityFrames)
+    {
+        size_t capacity = 1;
+        while (capacity < (size_t) minCapacityFrames)
+            capacity <<= 1;
+
+        numChannels = channels;
+        mask = capacity - 1;
+        samples.assign ((size_t) channels * capacity, 0.0f);
+        writeIndex.store (0);
+        readIndex.store (0);
+        numDroppedFrames.store (0);
+    }
+
+    int getNumChannels() const noexcept { return numChannels; }
+
+    // Producer thread only. channels: getNumChannels() pointers.
+    template <typename Sample>
+    bool push (const Sample* const* channels, int numFrames) noexcept
+    {
+        const size_t w = writeIndex.load (std::memory_order_relaxed);
+        if (samples.empty() || (size_t) numFrames > mask + 1 - (w - readIndex.load (std::memory_order_acquire)))
+        {
+            numDroppedFrames.fetch_add ((uint64_t) numFrames, std::memory_order_relaxed);
+            return false;
+        }
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            float* dest = samples.data() + (size_t) ch * (mask + 1);
+            for (int n = 0; n < numFrames; ++n)
+                dest[(w + (size_t) n) & mask] = (float) channels[ch][n];
+        }
+
+        writeIndex.store (w + (size_t) numFrames, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only: up to maxFrames into dest (getNumChannels() pointers), returns how many.
+    int pop (float* const* dest, int maxFrames) noexcept
+    {
+        const size_t r = readIndex.load (std::memory_order_relaxed);
+        const int numFrames = (int) std::min ((size_t) maxFrames, writeIndex.load (std::memory_order_acquire) - r);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const float* src = samples.data() + (size_t) ch * (mask + 1);
+            for (int n = 0; n < numFrames; ++n)
+                dest[ch][n] = src[(r + (size_t) n) & mask];
+        }
+
+        readIndex.store (r + (size_t) numFrames, std::memory_order_release);
+        return numFrames;
+    }
+
+    uint64_t getNumDroppedFrames() const noexcept { return numDroppedFrames.load (std::memory_order_relaxed); }
+
+private:
+    int numChannels = 0;
+    size_t mask = 0;
+    std::vector<float> samples; // channel ch at [ch * capacity, (ch + 1) * capacity)
+
+    alignas (64) std::atomic<size_t> writeIndex { 0 };
+    alignas (64) std::atomic<size_t> readIndex { 0 };
+    alignas (64) std::atomic<uint64_t> numDroppedFrames { 0 };
+};
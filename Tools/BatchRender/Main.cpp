@@ -0,0 +1,487 @@
+// Headless batch renderer: runs the compressor over WAV/AIFF files without a host or GUI.
+// Mono, stereo, 5.1, 7.1 and 7.1.4 files; each goes through a bus of its own layout.
+//
+//   StereoCompressorBatch --out <dir> [--preset <file>] [--set id=value ...]
+//                         [--threads N] [--block N] [--stats <file> [--deadline F]] <files or folders...>
+//
+// --preset takes either a state XML (what the plugin saves) or a text file of id=value lines.
+// --set overrides single parameters after the preset, e.g. --set threshold=-24 --set ratio=6:1
+// Each worker thread owns one processor instance and pulls files from a work-stealing queue.
+// Audio is streamed in --block sized chunks, so memory use doesn't depend on file length.
+// The processor's latency (lookahead, oversampling filters) is compensated: outputs line up with their inputs.
+// --stats writes the processors' audio-thread statistics (timing histogram, calls over F x the buffer
+// duration, NaN / denormal counts) as JSON; it needs a build with STEREOCOMP_INSTRUMENTATION (e.g. Debug).
+// Every file's line shows the integrated loudness and true peak going in and coming out (BS.1770).
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    std::mutex printLock;
+
+    void print (const juce::String& text)
+    {
+        const std::lock_guard<std::mutex> lock (printLock);
+        std::cout << text << std::endl;
+    }
+
+    //==============================================================================
+    // One deque per worker. A worker pops from the front of its own deque and,
+    // when that runs dry, steals from the back of the others.
+    class WorkStealingQueue
+    {
+    public:
+        explicit WorkStealingQueue (int numWorkers) : queues ((size_t) numWorkers) {}
+
+        void push (int worker, juce::File file)
+        {
+            auto& q = queues[(size_t) worker];
+            const std::lock_guard<std::mutex> lock (q.lock);
+            q.items.push_back (std::move (file));
+        }
+
+        bool pop (int worker, juce::File& result)
+        {
+            {
+                auto& own = queues[(size_t) worker];
+                const std::lock_guard<std::mutex> lock (own.lock);
+                if (! own.items.empty())
+                {
+                    result = std::move (own.items.front());
+                    own.items.pop_front();
+                    return true;
+                }
+            }
+
+            for (size_t i = 1; i < queues.size(); ++i)
+            {
+                auto& victim = queues[((size_t) worker + i) % queues.size()];
+                const std::lock_guard<std::mutex> lock (victim.lock);
+                if (! victim.items.empty())
+                {
+                    result = std::move (victim.items.back());
+                    victim.items.pop_back();
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    private:
+        struct PerWorker
+        {
+            std::mutex lock;
+            std::deque<juce::File> items;
+        };
+
+        std::vector<PerWorker> queues;
+    };
+
+    //==============================================================================
+    struct Settings
+    {
+        juce::File outDir;
+        juce::File preset;
+        juce::StringPairArray overrides; // parameter id -> value text
+        int numThreads = 0;
+        int blockSize = 512;
+        juce::File statsFile;
+        double deadlineFraction = 0.5;
+        juce::Array<juce::File> inputs;
+    };
+
+    void printUsage()
+    {
+        print ("usage: StereoCompressorBatch --out <dir> [--preset <file>] [--set id=value ...]\n"
+               "                             [--threads N] [--block N] [--stats <file> [--deadline F]] <files or folders...>");
+    }
+
+    bool isAudioFile (const juce::File& f)
+    {
+        return f.hasFileExtension ("wav;aif;aiff");
+    }
+
+    bool parseArgs (const juce::StringArray& args, Settings& s)
+    {
+        for (int i = 0; i < args.size(); ++i)
+        {
+            const auto& a = args[i];
+            const bool hasValue = i + 1 < args.size();
+
+            if (a == "--out" && hasValue)            s.outDir = juce::File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+            else if (a == "--preset" && hasValue)    s.preset = juce::File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+            else if (a == "--threads" && hasValue)   s.numThreads = args[++i].getIntValue();
+            else if (a == "--block" && hasValue)     s.blockSize = args[++i].getIntValue();
+            else if (a == "--stats" && hasValue)     s.statsFile = juce::File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+            else if (a == "--deadline" && hasValue)  s.deadlineFraction = args[++i].getDoubleValue();
+            else if (a == "--set" && hasValue)
+            {
+                const auto kv = args[++i];
+                if (! kv.containsChar ('='))
+                {
+                    print ("bad --set (expected id=value): " + kv);
+                    return false;
+                }
+                s.overrides.set (kv.upToFirstOccurrenceOf ("=", false, false).trim(),
+                                 kv.fromFirstOccurrenceOf ("=", false, false).trim());
+            }
+            else if (a.startsWith ("--"))
+            {
+                print ("unknown option: " + a);
+                return false;
+            }
+            else
+            {
+                const auto f = juce::File::getCurrentWorkingDirectory().getChildFile (a);
+                if (f.isDirectory())
+                    s.inputs.addArray (f.findChildFiles (juce::File::findFiles, false, "*.wav;*.aif;*.aiff"));
+                else if (f.existsAsFile() && isAudioFile (f))
+                    s.inputs.add (f);
+                else
+                    print ("skipping " + a);
+            }
+        }
+
+        if (s.outDir == juce::File() || s.inputs.isEmpty() || s.blockSize <= 0)
+            return false;
+
+        if (s.numThreads <= 0)
+            s.numThreads = juce::SystemStats::getNumCpus();
+        s.numThreads = juce::jlimit (1, s.inputs.size(), s.numThreads);
+        return true;
+    }
+
+    //==============================================================================
+    // Preset file first (state XML or id=value lines), then the --set overrides.
+    bool applyParameters (StereoCompressorBuild1AudioProcessor& proc, const Settings& s)
+    {
+        juce::StringPairArray values;
+
+        if (s.preset != juce::File())
+        {
+            if (auto xml = juce::parseXML (s.preset))
+            {
+                proc.apvts.replaceState (juce::ValueTree::fromXml (*xml));
+            }
+            else
+            {
+                juce::StringArray lines;
+                s.preset.readLines (lines);
+                for (auto line : lines)
+                {
+                    line = line.upToFirstOccurrenceOf ("#", false, false).trim();
+                    if (line.containsChar ('='))
+                        values.set (line.upToFirstOccurrenceOf ("=", false, false).trim(),
+                                    line.fromFirstOccurrenceOf ("=", false, false).trim());
+                }
+            }
+        }
+
+        values.addArray (s.overrides);
+
+        for (const auto& id : values.getAllKeys())
+        {
+            auto* param = proc.apvts.getParameter (id);
+            if (param == nullptr)
+            {
+                print ("unknown parameter: " + id);
+                return false;
+            }
+
+            const auto text = values[id];
+            const float normalised = text.containsOnly ("0123456789.-+eE")
+                                       ? param->convertTo0to1 (text.getFloatValue())
+                                       : param->getValueForText (text); // choice / bool names
+            param->setValueNotifyingHost (normalised);
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    struct FileResult
+    {
+        bool ok = false;
+        double audioSeconds = 0.0;
+        LoudnessAnalyser::Reading loudness[LoudnessAnalyser::numStreams];
+    };
+
+    juce::String describeLoudness (const LoudnessAnalyser::Reading& r)
+    {
+        return juce::String (r.integratedLufs, 1) + " LUFS / " + juce::String (r.truePeakDb, 1) + " dBTP";
+    }
+
+    // The bus the file goes through: mono goes through a stereo bus (both sides), everything else through
+    // the layout it declares (WAV channel mask) or, failing that, the standard one for its channel count
+    juce::AudioChannelSet busLayoutFor (juce::AudioFormatReader& reader, const StereoCompressorBuild1AudioProcessor& proc)
+    {
+        const int numChannels = (int) reader.numChannels;
+        if (numChannels <= 2)
+            return juce::AudioChannelSet::stereo();
+
+        auto isSupported = [&proc] (const juce::AudioChannelSet& set)
+        {
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add (set);
+            layout.inputBuses.add (juce::AudioChannelSet::disabled()); // no sidechain
+            layout.outputBuses.add (set);
+            return proc.checkBusesLayoutSupported (layout);
+        };
+
+        const auto declared = reader.getChannelLayout();
+        if (declared.size() == numChannels && isSupported (declared))
+            return declared;
+
+        for (const auto& set : { juce::AudioChannelSet::create5point1(), juce::AudioChannelSet::create7point1(),
+                                 juce::AudioChannelSet::create7point1point4() })
+            if (set.size() == numChannels)
+                return set;
+
+        return {};
+    }
+
+    FileResult renderFile (StereoCompressorBuild1AudioProcessor& proc,
+                           juce::AudioFormatManager& formats,
+                           const juce::File& in, const juce::File& outDir, int blockSize)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (in));
+        if (reader == nullptr)
+        {
+            print ("can't read " + in.getFullPathName());
+            return {};
+        }
+
+        const int numChannels = (int) reader->numChannels;
+        const auto busLayout = busLayoutFor (*reader, proc);
+        if (numChannels < 1 || busLayout.isDisabled())
+        {
+            print ("skipping " + in.getFileName() + " (" + juce::String (numChannels)
+                   + " channels: mono, stereo, 5.1, 7.1 and 7.1.4 are supported)");
+            return {};
+        }
+
+        const auto outFile = outDir.getChildFile (in.getFileName());
+        if (outFile == in)
+        {
+            print ("skipping " + in.getFileName() + " (--out must not be the input folder)");
+            return {};
+        }
+
+        auto* format = formats.findFormatForFileExtension (in.getFileExtension());
+        outFile.deleteFile();
+        auto out = outFile.createOutputStream();
+
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (format != nullptr && out != nullptr)
+            writer.reset (format->createWriterFor (out.get(), reader->sampleRate,
+                                                   numChannels == 1 ? juce::AudioChannelSet::mono() : busLayout,
+                                                   (int) reader->bitsPerSample, reader->metadataValues, 0));
+        if (writer == nullptr)
+        {
+            print ("can't write " + outFile.getFullPathName());
+            return {};
+        }
+        out.release(); // the writer owns the stream now
+
+        {
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add (busLayout);
+            layout.inputBuses.add (juce::AudioChannelSet::disabled());
+            layout.outputBuses.add (busLayout);
+            proc.setBusesLayout (layout); // between files, so never while prepared
+        }
+        proc.setRateAndBufferSizeDetails (reader->sampleRate, blockSize);
+        proc.getLoudnessAnalyser().setEnabled (true); // off unless asked for; the per-file lines need it
+        proc.prepareToPlay (reader->sampleRate, blockSize);
+
+        // mono files go through both sides of a stereo bus, and only the left side is written back
+        const int busChannels = busLayout.size();
+        juce::AudioBuffer<float> buffer (busChannels, blockSize);
+        juce::MidiBuffer midi;
+
+        // Latency compensation, as a host would do it: the first `latency` samples out are the delay line
+        // starting up and are dropped; as many zeros after the end of the file push its last samples out.
+        // The output file is as long as the input and lines up with it.
+        const juce::int64 latency = proc.getLatencySamples();
+        const juce::int64 total = reader->lengthInSamples + latency;
+
+        for (juce::int64 pos = 0; pos < total; pos += blockSize)
+        {
+            const int num = (int) juce::jmin ((juce::int64) blockSize, total - pos);
+            buffer.setSize (busChannels, num, false, false, true);
+            reader->read (&buffer, 0, num, pos, true, numChannels > 1); // past the end it reads zeros
+            if (numChannels == 1)
+                buffer.copyFrom (1, 0, buffer, 0, 0, num);
+
+            proc.processBlock (buffer, midi);
+            proc.getLoudnessAnalyser().flush(); // faster than real time: analyse here rather than drop blocks
+
+            const int skip = (int) juce::jlimit ((juce::int64) 0, (juce::int64) num, latency - pos);
+            if (skip < num)
+                writer->writeFromAudioSampleBuffer (buffer, skip, num - skip);
+        }
+
+        FileResult result { true, (double) reader->lengthInSamples / reader->sampleRate };
+        for (int s = 0; s < LoudnessAnalyser::numStreams; ++s)
+            result.loudness[s] = proc.getLoudnessAnalyser().getReading ((LoudnessAnalyser::Stream) s);
+
+        proc.releaseResources();
+        return result;
+    }
+
+    //==============================================================================
+   #if STEREOCOMP_INSTRUMENTATION
+    bool writeStats (const AudioThreadMonitor::Stats& stats, const juce::File& file)
+    {
+        auto* root = new juce::DynamicObject();
+        root->setProperty ("blocks", (juce::int64) stats.numBlocks);
+        root->setProperty ("meanNs", stats.getMeanNs());
+        root->setProperty ("p50Ns", stats.getPercentileNs (0.5));
+        root->setProperty ("p99Ns", stats.getPercentileNs (0.99));
+        root->setProperty ("p999Ns", stats.getPercentileNs (0.999));
+        root->setProperty ("maxNs", stats.maxNs);
+        root->setProperty ("deadlineFraction", stats.deadlineFraction);
+        root->setProperty ("overDeadline", (juce::int64) stats.numOverDeadline);
+        root->setProperty ("nonFiniteSamples", (juce::int64) stats.nonFiniteSamples);
+        root->setProperty ("blocksWithNonFinite", (juce::int64) stats.blocksWithNonFinite);
+        root->setProperty ("denormalSamples", (juce::int64) stats.denormalSamples);
+        root->setProperty ("realtimeViolations", (juce::int64) stats.realtimeViolations);
+
+        juce::Array<juce::var> histogram; // non-empty buckets only
+        for (int b = 0; b < AudioThreadMonitor::numBuckets; ++b)
+        {
+            if (stats.histogram[b] == 0)
+                continue;
+            auto* bucket = new juce::DynamicObject();
+            bucket->setProperty ("upToNs", AudioThreadMonitor::getBucketUpperNs (b));
+            bucket->setProperty ("count", (juce::int64) stats.histogram[b]);
+            histogram.add (juce::var (bucket));
+        }
+        root->setProperty ("histogram", histogram);
+
+        return file.replaceWithText (juce::JSON::toString (juce::var (root)));
+    }
+   #endif
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit; // message manager for the APVTS
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add (juce::String::fromUTF8 (argv[i]));
+
+    Settings settings;
+    if (! parseArgs (args, settings))
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (! settings.outDir.createDirectory())
+    {
+        print ("can't create " + settings.outDir.getFullPathName());
+        return 1;
+    }
+
+    // processors are created and configured here on the main thread; the workers only render
+    const int numWorkers = settings.numThreads;
+    std::vector<std::unique_ptr<StereoCompressorBuild1AudioProcessor>> processors;
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        processors.push_back (std::make_unique<StereoCompressorBuild1AudioProcessor>());
+        if (! applyParameters (*processors.back(), settings))
+            return 1;
+        processors.back()->updateGainCurve(); // the workers' prepareToPlay isn't on the message thread
+       #if STEREOCOMP_INSTRUMENTATION
+        processors.back()->setDeadlineFraction (settings.deadlineFraction);
+       #endif
+    }
+
+    // every processor is prepared again per file, which clears its counters: collect them after each file
+   #if STEREOCOMP_INSTRUMENTATION
+    std::vector<AudioThreadMonitor::Stats> workerStats ((size_t) numWorkers);
+   #endif
+
+    WorkStealingQueue queue (numWorkers);
+    for (int i = 0; i < settings.inputs.size(); ++i)
+        queue.push (i % numWorkers, settings.inputs[i]);
+
+    std::atomic<int> numDone { 0 }, numFailed { 0 };
+    std::atomic<double> totalAudioSeconds { 0.0 };
+
+    const auto startMs = juce::Time::getMillisecondCounterHiRes();
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < numWorkers; ++w)
+    {
+        workers.emplace_back ([&, w]
+        {
+            juce::AudioFormatManager formats;
+            formats.registerBasicFormats();
+
+            juce::File file;
+            while (queue.pop (w, file))
+            {
+                const auto result = renderFile (*processors[(size_t) w], formats, file, settings.outDir, settings.blockSize);
+               #if STEREOCOMP_INSTRUMENTATION
+                workerStats[(size_t) w].merge (processors[(size_t) w]->getAudioThreadStats());
+               #endif
+
+                if (result.ok)
+                {
+                    auto seconds = totalAudioSeconds.load();
+                    while (! totalAudioSeconds.compare_exchange_weak (seconds, seconds + result.audioSeconds)) {}
+                    print ("[" + juce::String (++numDone) + "/" + juce::String (settings.inputs.size()) + "] " + file.getFileName()
+                           + "  in " + describeLoudness (result.loudness[LoudnessAnalyser::input])
+                           + ", out " + describeLoudness (result.loudness[LoudnessAnalyser::output]));
+                }
+                else
+                {
+                    ++numFailed;
+                }
+            }
+        });
+    }
+
+    for (auto& t : workers)
+        t.join();
+
+    const double wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    const double audioSeconds = totalAudioSeconds.load();
+
+    print (juce::String (numDone.load()) + " files, " + juce::String (numFailed.load()) + " failed, "
+           + juce::String (numWorkers) + " threads");
+    print (juce::String (audioSeconds, 1) + " s of audio in " + juce::String (wallSeconds, 2) + " s = "
+           + juce::String (wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0, 1) + "x realtime");
+
+    if (settings.statsFile != juce::File())
+    {
+       #if STEREOCOMP_INSTRUMENTATION
+        AudioThreadMonitor::Stats total;
+        for (const auto& s : workerStats)
+            total.merge (s);
+
+        if (writeStats (total, settings.statsFile))
+            print ("wrote " + settings.statsFile.getFullPathName() + " (p99 " + juce::String (total.getPercentileNs (0.99) / 1000.0, 1)
+                   + " us, " + juce::String ((juce::int64) total.numOverDeadline) + " over deadline, "
+                   + juce::String ((juce::int64) total.nonFiniteSamples) + " nan/inf)");
+        else
+            print ("can't write " + settings.statsFile.getFullPathName());
+       #else
+        print ("--stats: this build has no audio-thread instrumentation (build Debug or set STEREOCOMP_INSTRUMENTATION)");
+       #endif
+    }
+
+    return numFailed.load() == 0 ? 0 : 2;
+}
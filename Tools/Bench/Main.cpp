@@ -0,0 +1,789 @@
+// processBlock microbenchmark.
+//
+//   StereoCompressorBench [--quick] [--seconds S] [--json <file>] [--label text]
+//
+// Sweeps block size (1..4096), sample rate (44.1k..192k), detector (Peak/RMS), sidechain HPF,
+// knee (0 / 6 dB) and link (0% / 100% unlink) over four synthetic signals, and reports
+// ns/sample, cycles/sample and the p99 time of a single processBlock call.
+// More tables price each oversampling factor / filter, each bus layout (stereo .. 7.1.4),
+// the multiband modes and float vs double processing at 48 kHz, the DSP core's specialised loops
+// against its general ones per mode, StreamBatch against one core per stream, and the last one the cost
+// of saving / restoring the plugin state.
+// --json writes every result so two runs (e.g. two commits) can be diffed.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "CompressorCore.h"
+#include "StreamBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+ #define BENCH_HAS_TSC 1
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    inline juce::uint64 readCycles()
+    {
+       #if BENCH_HAS_TSC
+        return (juce::uint64) __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    //==============================================================================
+    enum class Signal { sine, pinkNoise, drums, silence };
+
+    const char* signalName (Signal s)
+    {
+        switch (s)
+        {
+            case Signal::sine:      return "sine";
+            case Signal::pinkNoise: return "pink";
+            case Signal::drums:     return "drums";
+            case Signal::silence:   return "silence";
+        }
+        return "";
+    }
+
+    // stereo, deterministic (fixed seed) so runs are comparable
+    juce::AudioBuffer<float> makeSignal (Signal type, double sampleRate, int numSamples)
+    {
+        juce::AudioBuffer<float> buf (2, numSamples);
+        buf.clear();
+        juce::Random rng (1234);
+
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            auto* d = buf.getWritePointer (ch);
+
+            switch (type)
+            {
+                case Signal::sine:
+                {
+                    const double w = juce::MathConstants<double>::twoPi * (ch == 0 ? 440.0 : 660.0) / sampleRate;
+                    for (int n = 0; n < numSamples; ++n)
+                        d[n] = 0.5f * (float) std::sin (w * n);
+                    break;
+                }
+
+                case Signal::pinkNoise: // Paul Kellet's economy filter
+                {
+                    float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+                    for (int n = 0; n < numSamples; ++n)
+                    {
+                        const float white = rng.nextFloat() * 2.0f - 1.0f;
+                        b0 = 0.99765f * b0 + white * 0.0990460f;
+                        b1 = 0.96300f * b1 + white * 0.2965164f;
+                        b2 = 0.57000f * b2 + white * 1.0526913f;
+                        d[n] = 0.2f * (b0 + b1 + b2 + white * 0.1848f);
+                    }
+                    break;
+                }
+
+                case Signal::drums: // kick + noise snare on a 120 bpm grid, fast attack / exponential decay
+                {
+                    const int beat = (int) (sampleRate * 0.5);
+                    for (int n = 0; n < numSamples; ++n)
+                    {
+                        const int pos = n % beat;
+                        const bool snare = ((n / beat) % 2) == 1;
+                        const float t = (float) (pos / sampleRate);
+                        const float env = std::exp (-t * (snare ? 25.0f : 12.0f));
+                        const float body = snare ? (rng.nextFloat() * 2.0f - 1.0f)
+                                                 : (float) std::sin (juce::MathConstants<double>::twoPi * 55.0 * t);
+                        d[n] = 0.9f * env * body;
+                    }
+                    break;
+                }
+
+                case Signal::silence:
+                    break;
+            }
+        }
+
+        return buf;
+    }
+
+    //==============================================================================
+    struct Config
+    {
+        Signal signal;
+        double sampleRate;
+        int blockSize;
+        int detectorMode; // 0 = Peak, 1 = RMS
+        bool hpf;
+        float kneeDb;
+        float unlinkPct;
+        int oversampling = 0; // 0 = 1x, 1 = 2x, 2 = 4x
+        int osFilter = 0;     // 0 = IIR, 1 = FIR
+        juce::AudioChannelSet layout = juce::AudioChannelSet::stereo();
+        int multiband = 0;    // 0 = off, 1 = 3 bands, 2 = 4 bands
+        int precision = 0;    // 0 = float, 1 = double, 2 = double converted to float and back (no double support)
+    };
+
+    struct Result
+    {
+        double nsPerSample = 0.0;
+        double cyclesPerSample = 0.0;
+        double p99BlockNs = 0.0;
+        double maxBlockNs = 0.0;
+        double skippedBlockFraction = 0.0; // timed blocks the idle path skipped
+    };
+
+    void setParameter (StereoCompressorBuild1AudioProcessor& proc, const juce::String& id, float value)
+    {
+        if (auto* p = proc.apvts.getParameter (id))
+            p->setValueNotifyingHost (p->convertTo0to1 (value));
+    }
+
+    Result run (StereoCompressorBuild1AudioProcessor& proc, const Config& c, const juce::AudioBuffer<float>& input)
+    {
+        setParameter (proc, "detectorMode", (float) c.detectorMode);
+        setParameter (proc, "scHPfOn",      c.hpf ? 1.0f : 0.0f);
+        setParameter (proc, "knee",         c.kneeDb);
+        setParameter (proc, "unlink",       c.unlinkPct);
+        setParameter (proc, "threshold",    -24.0f);
+        setParameter (proc, "oversampling", (float) c.oversampling);
+        setParameter (proc, "osFilter",     (float) c.osFilter);
+        setParameter (proc, "mbMode",       (float) c.multiband);
+
+        juce::AudioProcessor::BusesLayout buses;
+        buses.inputBuses.add (c.layout);
+        buses.inputBuses.add (juce::AudioChannelSet::disabled()); // sidechain not connected
+        buses.outputBuses.add (c.layout);
+        proc.setBusesLayout (buses);
+        proc.setRateAndBufferSizeDetails (c.sampleRate, c.blockSize);
+        proc.setProcessingPrecision (c.precision == 1 ? juce::AudioProcessor::doublePrecision
+                                                      : juce::AudioProcessor::singlePrecision);
+        proc.prepareToPlay (c.sampleRate, c.blockSize);
+
+        const int numChannels = c.layout.size();
+        juce::AudioBuffer<float> block (numChannels, c.blockSize);
+        juce::AudioBuffer<double> blockDouble (c.precision != 0 ? numChannels : 0, c.precision != 0 ? c.blockSize : 0);
+        juce::MidiBuffer midi;
+
+        const int numSamples = input.getNumSamples();
+        const int numBlocks = numSamples / c.blockSize;
+
+        auto copyIn = [&] (int b)
+        {
+            for (int ch = 0; ch < numChannels; ++ch) // wider layouts reuse the stereo pair
+                block.copyFrom (ch, 0, input, ch % 2, b * c.blockSize, c.blockSize);
+            if (c.precision != 0)
+                blockDouble.makeCopyOf (block, true);
+        };
+
+        auto process = [&]
+        {
+            if (c.precision == 0)
+            {
+                proc.processBlock (block, midi);
+            }
+            else if (c.precision == 1)
+            {
+                proc.processBlock (blockDouble, midi);
+            }
+            else // what the host does for a float-only plugin in a 64-bit engine
+            {
+                block.makeCopyOf (blockDouble, true);
+                proc.processBlock (block, midi);
+                blockDouble.makeCopyOf (block, true);
+            }
+        };
+
+        // warm-up: the first tenth, untimed
+        for (int b = 0; b < juce::jmax (1, numBlocks / 10); ++b)
+        {
+            copyIn (b);
+            process();
+        }
+
+        std::vector<double> blockNs ((size_t) numBlocks);
+        const auto skippedBefore = proc.getNumSkippedBlocks(), blocksBefore = proc.getNumBlocks();
+        juce::uint64 totalCycles = 0;
+        double totalNs = 0.0;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            copyIn (b);
+
+            const auto t0 = Clock::now();
+            const auto c0 = readCycles();
+            process();
+            const auto c1 = readCycles();
+            const auto t1 = Clock::now();
+
+            blockNs[(size_t) b] = (double) std::chrono::duration_cast<std::chrono::nanoseconds> (t1 - t0).count();
+            totalNs += blockNs[(size_t) b];
+            totalCycles += c1 - c0;
+        }
+
+        const auto skipped = proc.getNumSkippedBlocks() - skippedBefore, blocks = proc.getNumBlocks() - blocksBefore;
+        proc.releaseResources();
+
+        Result r;
+        r.skippedBlockFraction = blocks > 0 ? (double) skipped / (double) blocks : 0.0;
+        const double processed = (double) numBlocks * c.blockSize;
+        r.nsPerSample = totalNs / processed;
+        r.cyclesPerSample = (double) totalCycles / processed;
+
+        std::sort (blockNs.begin(), blockNs.end());
+        r.p99BlockNs = blockNs[(size_t) ((blockNs.size() - 1) * 99 / 100)];
+        r.maxBlockNs = blockNs.back();
+        return r;
+    }
+
+    // The DSP core on its own, no processor around it: stereo input in blockSize pieces, output kept
+    // in `output` so two runs can be compared sample for sample. Returns ns/sample over the whole input.
+    double runCore (CompressorCore& core, const CompressorCore::Parameters& params, double sampleRate, int blockSize,
+                    const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output)
+    {
+        core.allocate (2, blockSize, CompressorCore::maxLookaheadSamplesFor (sampleRate));
+        core.setSampleRate (sampleRate);
+        core.setParameters (params);
+
+        const int numBlocks = input.getNumSamples() / blockSize;
+        output.makeCopyOf (input);
+        float* channels[2];
+
+        const auto t0 = Clock::now();
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int ch = 0; ch < 2; ++ch)
+                channels[ch] = output.getWritePointer (ch, b * blockSize);
+            core.process (channels, blockSize);
+        }
+        const auto ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds> (Clock::now() - t0).count();
+
+        return ns / ((double) numBlocks * blockSize);
+    }
+
+    bool identical (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        for (int ch = 0; ch < a.getNumChannels(); ++ch)
+            if (std::memcmp (a.getReadPointer (ch), b.getReadPointer (ch), sizeof (float) * (size_t) a.getNumSamples()) != 0)
+                return false;
+        return true;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    bool quick = false;
+    double seconds = 0.5;
+    juce::File jsonFile;
+    juce::String label;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String a (argv[i]);
+        if (a == "--quick")                           quick = true;
+        else if (a == "--seconds" && i + 1 < argc)    seconds = juce::String (argv[++i]).getDoubleValue();
+        else if (a == "--json" && i + 1 < argc)       jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else if (a == "--label" && i + 1 < argc)      label = argv[++i];
+        else
+        {
+            std::cout << "usage: StereoCompressorBench [--quick] [--seconds S] [--json <file>] [--label text]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<int> blockSizes;
+    std::vector<double> sampleRates;
+    if (quick)
+    {
+        blockSizes  = { 32, 512, 4096 };
+        sampleRates = { 48000.0 };
+    }
+    else
+    {
+        for (int b = 1; b <= 4096; b *= 2)
+            blockSizes.push_back (b);
+        sampleRates = { 44100.0, 48000.0, 88200.0, 96000.0, 192000.0 };
+    }
+
+    const Signal signals[] = { Signal::sine, Signal::pinkNoise, Signal::drums, Signal::silence };
+
+    StereoCompressorBuild1AudioProcessor proc;
+
+    juce::Array<juce::var> results;
+
+    std::cout << "gain computer kernel: " << GainComputer::getKernelName()
+              << ", max error vs reference: " << GainComputer::measureMaxErrorDb() << " dB" << std::endl;
+    std::cout << "gain curve table max error vs reference: " << GainCurveTable::measureMaxErrorDb() << " dB" << std::endl;
+    std::cout << "signal  sr      block  det   hpf knee unlink   ns/smp  cyc/smp   p99 blk ns  idle" << std::endl;
+
+    for (auto sr : sampleRates)
+    {
+        for (auto sig : signals)
+        {
+            // whole number of 4096 blocks so every block size sees the same audio
+            const int numSamples = juce::jmax (4096, (int) (seconds * sr) / 4096 * 4096);
+            const auto input = makeSignal (sig, sr, numSamples);
+
+            for (auto bs : blockSizes)
+                for (int det = 0; det < 2; ++det)
+                    for (int hpf = 0; hpf < 2; ++hpf)
+                        for (float knee : { 0.0f, 6.0f })
+                            for (float unlink : { 0.0f, 100.0f })
+                            {
+                                const Config c { sig, sr, bs, det, hpf != 0, knee, unlink };
+                                const auto r = run (proc, c, input);
+
+                                std::cout << juce::String (signalName (sig)).paddedRight (' ', 8)
+                                          << juce::String ((int) sr).paddedRight (' ', 8)
+                                          << juce::String (bs).paddedRight (' ', 7)
+                                          << (det == 0 ? "peak  " : "rms   ")
+                                          << (hpf != 0 ? "on  " : "off ")
+                                          << juce::String ((int) knee).paddedRight (' ', 5)
+                                          << juce::String ((int) unlink).paddedRight (' ', 7)
+                                          << juce::String (r.nsPerSample, 2).paddedLeft (' ', 8)
+                                          << juce::String (r.cyclesPerSample, 1).paddedLeft (' ', 9)
+                                          << juce::String (r.p99BlockNs, 0).paddedLeft (' ', 13)
+                                          << juce::String (juce::roundToInt (r.skippedBlockFraction * 100.0)).paddedLeft (' ', 5) << "%" << std::endl;
+
+                                auto* o = new juce::DynamicObject();
+                                o->setProperty ("signal", signalName (sig));
+                                o->setProperty ("sampleRate", sr);
+                                o->setProperty ("blockSize", bs);
+                                o->setProperty ("detector", det == 0 ? "peak" : "rms");
+                                o->setProperty ("hpf", hpf != 0);
+                                o->setProperty ("kneeDb", knee);
+                                o->setProperty ("unlinkPct", unlink);
+                                o->setProperty ("nsPerSample", r.nsPerSample);
+                                o->setProperty ("cyclesPerSample", r.cyclesPerSample);
+                                o->setProperty ("p99BlockNs", r.p99BlockNs);
+                                o->setProperty ("maxBlockNs", r.maxBlockNs);
+                                o->setProperty ("skippedBlockFraction", r.skippedBlockFraction);
+                                results.add (juce::var (o));
+                            }
+        }
+    }
+
+    // Oversampling cost per factor / filter: 48 kHz, 512-sample blocks, pink noise, default settings
+    juce::Array<juce::var> osResults;
+    {
+        const double sr = 48000.0;
+        const int numSamples = juce::jmax (4096, (int) (seconds * sr) / 4096 * 4096);
+        const auto input = makeSignal (Signal::pinkNoise, sr, numSamples);
+
+        std::cout << std::endl << "oversampling  filter  ns/smp  cyc/smp   p99 blk ns  latency" << std::endl;
+
+        for (int os = 0; os < 3; ++os)
+            for (int filter = 0; filter < (os == 0 ? 1 : 2); ++filter)
+            {
+                Config c { Signal::pinkNoise, sr, 512, 0, false, 6.0f, 0.0f };
+                c.oversampling = os;
+                c.osFilter = filter;
+                const auto r = run (proc, c, input);
+
+                std::cout << juce::String (1 << os).paddedRight (' ', 14)
+                          << (os == 0 ? "-       " : (filter == 0 ? "iir     " : "fir     "))
+                          << juce::String (r.nsPerSample, 2).paddedLeft (' ', 6)
+                          << juce::String (r.cyclesPerSample, 1).paddedLeft (' ', 9)
+                          << juce::String (r.p99BlockNs, 0).paddedLeft (' ', 13)
+                          << juce::String (proc.getLatencySamples()).paddedLeft (' ', 9) << std::endl;
+
+                auto* o = new juce::DynamicObject();
+                o->setProperty ("factor", 1 << os);
+                o->setProperty ("filter", os == 0 ? "none" : (filter == 0 ? "iir" : "fir"));
+                o->setProperty ("nsPerSample", r.nsPerSample);
+                o->setProperty ("cyclesPerSample", r.cyclesPerSample);
+                o->setProperty ("p99BlockNs", r.p99BlockNs);
+                o->setProperty ("latencySamples", proc.getLatencySamples());
+                osResults.add (juce::var (o));
+            }
+    }
+
+    // Channel scaling: cost per sample frame for each supported layout, 48 kHz, 512-sample blocks
+    juce::Array<juce::var> layoutResults;
+    {
+        const double sr = 48000.0;
+        const int numSamples = juce::jmax (4096, (int) (seconds * sr) / 4096 * 4096);
+        const auto input = makeSignal (Signal::pinkNoise, sr, numSamples);
+
+        const std::pair<const char*, juce::AudioChannelSet> layouts[] = {
+            { "stereo", juce::AudioChannelSet::stereo() },
+            { "5.1",    juce::AudioChannelSet::create5point1() },
+            { "7.1",    juce::AudioChannelSet::create7point1() },
+            { "7.1.4",  juce::AudioChannelSet::create7point1point4() }
+        };
+
+        std::cout << std::endl << "layout  channels  ns/frame  ns/ch-smp" << std::endl;
+
+        for (const auto& l : layouts)
+        {
+            Config c { Signal::pinkNoise, sr, 512, 0, false, 6.0f, 0.0f };
+            c.layout = l.second;
+            const auto r = run (proc, c, input);
+            const int numChannels = l.second.size();
+
+            std::cout << juce::String (l.first).paddedRight (' ', 8)
+                      << juce::String (numChannels).paddedRight (' ', 10)
+                      << juce::String (r.nsPerSample, 2).paddedLeft (' ', 8)
+                      << juce::String (r.nsPerSample / numChannels, 2).paddedLeft (' ', 11) << std::endl;
+
+            auto* o = new juce::DynamicObject();
+            o->setProperty ("layout", l.first);
+            o->setProperty ("channels", numChannels);
+            o->setProperty ("nsPerFrame", r.nsPerSample);
+            o->setProperty ("nsPerChannelSample", r.nsPerSample / numChannels);
+            layoutResults.add (juce::var (o));
+        }
+    }
+
+    // Multiband: broadband vs 3 / 4 bands, stereo, 48 kHz, 512-sample blocks
+    juce::Array<juce::var> multibandResults;
+    {
+        const double sr = 48000.0;
+        const int numSamples = juce::jmax (4096, (int) (seconds * sr) / 4096 * 4096);
+        const auto input = makeSignal (Signal::pinkNoise, sr, numSamples);
+        const char* names[] = { "off", "3 bands", "4 bands" };
+
+        std::cout << std::endl << "multiband  detector  ns/smp  cyc/smp" << std::endl;
+
+        for (int mb = 0; mb < 3; ++mb)
+        {
+            for (int detector = 0; detector < 2; ++detector)
+            {
+                Config c { Signal::pinkNoise, sr, 512, detector, false, 6.0f, 0.0f };
+                c.multiband = mb;
+                const auto r = run (proc, c, input);
+
+                std::cout << juce::String (names[mb]).paddedRight (' ', 11)
+                          << juce::String (detector == 0 ? "Peak" : "RMS").paddedRight (' ', 8)
+                          << juce::String (r.nsPerSample, 2).paddedLeft (' ', 8)
+                          << juce::String (r.cyclesPerSample, 1).paddedLeft (' ', 9) << std::endl;
+
+                auto* o = new juce::DynamicObject();
+                o->setProperty ("multiband", names[mb]);
+                o->setProperty ("detector", detector == 0 ? "Peak" : "RMS");
+                o->setProperty ("nsPerSample", r.nsPerSample);
+                o->setProperty ("cyclesPerSample", r.cyclesPerSample);
+                multibandResults.add (juce::var (o));
+            }
+        }
+    }
+
+    // Precision: native double vs float, and vs the double -> float -> double round trip it replaces
+    juce::Array<juce::var> precisionResults;
+    {
+        const double sr = 48000.0;
+        const int numSamples = juce::jmax (4096, (int) (seconds * sr) / 4096 * 4096);
+        const auto input = makeSignal (Signal::pinkNoise, sr, numSamples);
+        const char* names[] = { "float", "double", "double via float" };
+
+        std::cout << std::endl << "precision          block  ns/smp  cyc/smp" << std::endl;
+
+        for (int bs : { 64, 512 })
+        {
+            for (int precision = 0; precision < 3; ++precision)
+            {
+                Config c { Signal::pinkNoise, sr, bs, 0, false, 6.0f, 0.0f };
+                c.precision = precision;
+                const auto r = run (proc, c, input);
+
+                std::cout << juce::String (names[precision]).paddedRight (' ', 19)
+                          << juce::String (bs).paddedRight (' ', 5)
+                          << juce::String (r.nsPerSample, 2).paddedLeft (' ', 8)
+                          << juce::String (r.cyclesPerSample, 1).paddedLeft (' ', 9) << std::endl;
+
+                auto* o = new juce::DynamicObject();
+                o->setProperty ("precision", names[precision]);
+                o->setProperty ("blockSize", bs);
+                o->setProperty ("nsPerSample", r.nsPerSample);
+                o->setProperty ("cyclesPerSample", r.cyclesPerSample);
+                precisionResults.add (juce::var (o));
+            }
+        }
+    }
+
+    // Specialisation: the core's per-mode loops vs its general ones (setSpecialisedLoops (false)), stereo, 48 kHz,
+    // 512-sample blocks, pink noise; "bank" is the specialised loop without the stereo pair detector
+    // (setStereoPairLoop (false)). The outputs have to match bit for bit; "same" says whether they did.
+    juce::Array<juce::var> specialisationResults;
+    bool pluginUsesPairLoop = false;
+    {
+        const double sr = 48000.0;
+        const int numSamples = juce::jmax (4096, (int) (seconds * sr) / 4096 * 4096);
+        const auto input = makeSignal (Signal::pinkNoise, sr, numSamples);
+        juce::AudioBuffer<float> generalOut, bankOut, specialisedOut;
+        CompressorCore core;
+
+        // the pair loop only pays off if the plugin takes it: a stereo bus, every link mode
+        bool pluginPair = true;
+        {
+            juce::AudioProcessor::BusesLayout buses;
+            buses.inputBuses.add (juce::AudioChannelSet::stereo());
+            buses.inputBuses.add (juce::AudioChannelSet::disabled());
+            buses.outputBuses.add (juce::AudioChannelSet::stereo());
+            proc.setBusesLayout (buses);
+            proc.setProcessingPrecision (juce::AudioProcessor::singlePrecision);
+
+            for (int linkMode = 0; linkMode < 3; ++linkMode)
+            {
+                setParameter (proc, "linkMode", (float) linkMode);
+                proc.prepareToPlay (sr, 512);
+                pluginPair = pluginPair && proc.isUsingStereoPairLoop();
+                proc.releaseResources();
+            }
+            setParameter (proc, "linkMode", 0.0f);
+        }
+
+        pluginUsesPairLoop = pluginPair;
+        std::cout << std::endl << "plugin, stereo bus: " << (pluginPair ? "pair loop" : "NOT the pair loop") << std::endl;
+        std::cout << "specialisation  det   hpf knee unlink  general     bank     pair  speedup  same" << std::endl;
+
+        for (int det = 0; det < 2; ++det)
+            for (int hpf = 0; hpf < 2; ++hpf)
+                for (float knee : { 0.0f, 6.0f })
+                    for (float unlink : { 0.0f, 100.0f, 50.0f })
+                    {
+                        CompressorCore::Parameters params;
+                        params.detectorMode = det;
+                        params.scHpfOn = hpf != 0;
+                        params.kneeDb = knee;
+                        params.unlinkPct = unlink;
+                        params.thresholdDb = -24.0f;
+
+                        core.setSpecialisedLoops (false);
+                        const double generalNs = runCore (core, params, sr, 512, input, generalOut);
+                        core.setSpecialisedLoops (true);
+                        core.setStereoPairLoop (false);
+                        const double bankNs = runCore (core, params, sr, 512, input, bankOut);
+                        core.setStereoPairLoop (true);
+                        const double specialisedNs = runCore (core, params, sr, 512, input, specialisedOut);
+                        const bool same = identical (generalOut, bankOut) && identical (generalOut, specialisedOut);
+
+                        std::cout << juce::String().paddedRight (' ', 16)
+                                  << (det == 0 ? "peak  " : "rms   ")
+                                  << (hpf != 0 ? "on  " : "off ")
+                                  << juce::String ((int) knee).paddedRight (' ', 5)
+                                  << juce::String ((int) unlink).paddedRight (' ', 6)
+                                  << juce::String (generalNs, 2).paddedLeft (' ', 8)
+                                  << juce::String (bankNs, 2).paddedLeft (' ', 9)
+                                  << juce::String (specialisedNs, 2).paddedLeft (' ', 9)
+                                  << juce::String (generalNs / specialisedNs, 2).paddedLeft (' ', 8) << "x"
+                                  << (same ? "  yes" : "  NO") << std::endl;
+
+                        auto* o = new juce::DynamicObject();
+                        o->setProperty ("detector", det == 0 ? "peak" : "rms");
+                        o->setProperty ("hpf", hpf != 0);
+                        o->setProperty ("kneeDb", knee);
+                        o->setProperty ("unlinkPct", unlink);
+                        o->setProperty ("generalNsPerSample", generalNs);
+                        o->setProperty ("bankNsPerSample", bankNs);
+                        o->setProperty ("specialisedNsPerSample", specialisedNs);
+                        o->setProperty ("speedup", generalNs / specialisedNs);
+                                    specialisationResults.add (juce::var (o));
+                    }
+    }
+
+    // Streams: StreamBatch (many stereo streams, four per SIMD register, split over threads) against one core
+    // per stream, 48 kHz, 4096-sample blocks, pink noise at a different offset per stream. Timing only: that
+    // the outputs match bit for bit is StereoCompressorRegression's job.
+    juce::Array<juce::var> streamResults;
+    {
+        const double sr = 48000.0;
+        const int blockSize = 4096;
+        const int numStreams = quick ? 64 : 512;
+        const int numSamples = 4 * blockSize;
+        const auto source = makeSignal (Signal::pinkNoise, sr, 2 * numSamples);
+
+        CompressorCore::Parameters params;
+        params.scHpfOn = true;
+        params.unlinkPct = 50.0f;
+        params.thresholdDb = -24.0f;
+
+        juce::AudioBuffer<float> audio (2 * numStreams, numSamples);
+        std::vector<float*> left ((size_t) numStreams), right ((size_t) numStreams);
+        auto fill = [&]
+        {
+            for (int s = 0; s < numStreams; ++s)
+            {
+                const int offset = (s * 997) % numSamples;
+                audio.copyFrom (2 * s, 0, source, 0, offset, numSamples);
+                audio.copyFrom (2 * s + 1, 0, source, 1, offset, numSamples);
+                left[(size_t) s] = audio.getWritePointer (2 * s);
+                right[(size_t) s] = audio.getWritePointer (2 * s + 1);
+            }
+        };
+
+        // one core per stream, the way it would be without the batch (one core reused, state cleared)
+        double coreNs = 0.0;
+        {
+            fill();
+            CompressorCore core;
+            core.allocate (2, blockSize, 0);
+
+            const auto t0 = Clock::now();
+            for (int s = 0; s < numStreams; ++s)
+            {
+                core.setSampleRate (sr);
+                core.setParameters (params);
+                for (int start = 0; start < numSamples; start += blockSize)
+                {
+                    float* channels[] = { left[(size_t) s] + start, right[(size_t) s] + start };
+                    core.process (channels, blockSize);
+                }
+            }
+            coreNs = std::chrono::duration<double, std::nano> (Clock::now() - t0).count() / ((double) numStreams * numSamples);
+        }
+
+        std::cout << std::endl << "streams  threads  ns/stream-frame  speedup   (one core per stream: "
+                  << juce::String (coreNs, 2) << " ns)" << std::endl;
+
+        std::vector<int> threadCounts { 1 };
+        for (int t = 2; t <= juce::SystemStats::getNumCpus(); t *= 2)
+            threadCounts.push_back (t);
+
+        for (int threads : threadCounts)
+        {
+            fill();
+            StreamBatch batch;
+            batch.allocate (numStreams, blockSize, threads);
+            batch.setSampleRate (sr);
+            batch.setParameters (params);
+
+            std::vector<float*> l ((size_t) numStreams), r ((size_t) numStreams);
+
+            const auto t0 = Clock::now();
+            for (int start = 0; start < numSamples; start += blockSize)
+            {
+                for (int s = 0; s < numStreams; ++s)
+                {
+                    l[(size_t) s] = left[(size_t) s] + start;
+                    r[(size_t) s] = right[(size_t) s] + start;
+                }
+                batch.process (l.data(), r.data(), blockSize);
+            }
+            const double ns = std::chrono::duration<double, std::nano> (Clock::now() - t0).count() / ((double) numStreams * numSamples);
+
+            std::cout << juce::String (numStreams).paddedRight (' ', 9)
+                      << juce::String (batch.getNumThreads()).paddedRight (' ', 9)
+                      << juce::String (ns, 2).paddedLeft (' ', 15)
+                      << juce::String (coreNs / ns, 2).paddedLeft (' ', 8) << "x" << std::endl;
+
+            auto* o = new juce::DynamicObject();
+            o->setProperty ("streams", numStreams);
+            o->setProperty ("threads", batch.getNumThreads());
+            o->setProperty ("nsPerStreamFrame", ns);
+            o->setProperty ("corePerStreamNs", coreNs);
+            o->setProperty ("speedup", coreNs / ns);
+            o->setProperty ("identical", same);
+            streamResults.add (juce::var (o));
+        }
+    }
+
+    // State: per-instance cost of saving / restoring, binary chunk vs the APVTS XML chunk it replaced.
+    // Restores alternate between two different settings so every call really changes the parameters.
+    juce::Array<juce::var> stateResults;
+    {
+        const int iterations = quick ? 200 : 2000;
+
+        auto perCallUs = [iterations] (auto&& fn)
+        {
+            const auto t0 = Clock::now();
+            for (int i = 0; i < iterations; ++i)
+                fn (i);
+            return std::chrono::duration<double, std::micro> (Clock::now() - t0).count() / iterations;
+        };
+
+        auto xmlChunk = [&proc]
+        {
+            juce::MemoryBlock block;
+            if (auto xml = proc.apvts.copyState().createXml())
+                juce::AudioProcessor::copyXmlToBinary (*xml, block);
+            return block;
+        };
+
+        juce::MemoryBlock binary[2], xml[2];
+        for (int k = 0; k < 2; ++k)
+        {
+            for (const char* id : { "threshold", "makeup", "attack", "release", "unlink", "xover2", "band3Threshold" })
+                if (auto* param = proc.apvts.getParameter (id))
+                    param->setValueNotifyingHost (k == 0 ? 0.25f : 0.75f);
+            proc.getStateInformation (binary[k]);
+            xml[k] = xmlChunk();
+        }
+
+        struct Row { const char* name; size_t bytes; double us; };
+        juce::MemoryBlock scratch;
+        const Row rows[] = {
+            { "binary save", binary[0].getSize(), perCallUs ([&] (int) { proc.getStateInformation (scratch); }) },
+            { "binary load", binary[0].getSize(), perCallUs ([&] (int i) { proc.setStateInformation (binary[i & 1].getData(), (int) binary[i & 1].getSize()); }) },
+            { "xml save (old)", xml[0].getSize(), perCallUs ([&] (int) { scratch = xmlChunk(); }) },
+            { "xml load (old)", xml[0].getSize(), perCallUs ([&] (int i)
+                {
+                    if (auto e = juce::AudioProcessor::getXmlFromBinary (xml[i & 1].getData(), (int) xml[i & 1].getSize()))
+                        proc.apvts.replaceState (juce::ValueTree::fromXml (*e));
+                }) },
+            { "xml import", xml[0].getSize(), perCallUs ([&] (int i) { proc.setStateInformation (xml[i & 1].getData(), (int) xml[i & 1].getSize()); }) },
+        };
+
+        std::cout << std::endl << "state            bytes   us/call" << std::endl;
+        for (const auto& row : rows)
+        {
+            std::cout << juce::String (row.name).paddedRight (' ', 15)
+                      << juce::String ((int) row.bytes).paddedLeft (' ', 7)
+                      << juce::String (row.us, 2).paddedLeft (' ', 10) << std::endl;
+
+            auto* o = new juce::DynamicObject();
+            o->setProperty ("operation", row.name);
+            o->setProperty ("bytes", (int) row.bytes);
+            o->setProperty ("usPerCall", row.us);
+            stateResults.add (juce::var (o));
+        }
+    }
+
+    if (jsonFile != juce::File())
+    {
+        auto* root = new juce::DynamicObject();
+        root->setProperty ("label", label);
+        root->setProperty ("date", juce::Time::getCurrentTime().toISO8601 (true));
+        root->setProperty ("cpu", juce::SystemStats::getCpuModel());
+       #if BENCH_HAS_TSC
+        root->setProperty ("cyclesSource", "tsc");
+       #else
+        root->setProperty ("cyclesSource", "none");
+       #endif
+        root->setProperty ("gainComputerKernel", GainComputer::getKernelName());
+        root->setProperty ("gainComputerMaxErrorDb", GainComputer::measureMaxErrorDb());
+        root->setProperty ("gainCurveTableMaxErrorDb", GainCurveTable::measureMaxErrorDb());
+        root->setProperty ("results", results);
+        root->setProperty ("oversampling", osResults);
+        root->setProperty ("layouts", layoutResults);
+        root->setProperty ("multiband", multibandResults);
+        root->setProperty ("precision", precisionResults);
+        root->setProperty ("specialisation", specialisationResults);
+        root->setProperty ("pluginUsesStereoPairLoop", pluginUsesPairLoop);
+        root->setProperty ("streams", streamResults);
+        root->setProperty ("state", stateResults);
+
+        if (! jsonFile.replaceWithText (juce::JSON::toString (juce::var (root))))
+        {
+            std::cout << "can't write " << jsonFile.getFullPathName() << std::endl;
+            return 1;
+        }
+        std::cout << "wrote " << jsonFile.getFullPathName() << std::endl;
+    }
+
+    return 0;
+}
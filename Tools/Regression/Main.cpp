@@ -0,0 +1,682 @@
+// Regression and differential check of processBlock's DSP paths.
+//
+//   StereoCompressorRegression [--quick] [--golden <file>] [--write-golden <file>] [--random N] [--seed S]
+//
+// Renders a fixed matrix - every ratio choice, Peak / RMS, sidechain HPF off / on, unlink 0 / 50 / 100,
+// each combination at one point of a threshold x knee x attack / release grid, at 44.1, 48 and 96 kHz in
+// 64 and 512-sample blocks (--quick: 48 kHz / 512 only) - through processBlock on the reference path:
+// general loops, exact log10 / pow gain curve, no table (see the processor's DspPaths). Then renders every
+// case again on each fast path and compares it with the reference:
+//
+//   loops     specialised + stereo pair detector loops            bit for bit
+//   kernel    loops + the SIMD gain curve                          gain within 0.001 dB
+//   table     kernel + the curve table (what the plugin runs)      gain within 0.02 dB
+//   double    the reference path in double precision               gain within 0.001 dB
+//   double+   every fast path, double precision                    gain within 0.02 dB
+//
+// StreamBatch has to match a two-channel CompressorCore per stream bit for bit, over a few settings,
+// stream counts that aren't multiples of four and more than one thread.
+//
+// Each render also asks the processor which detector loop it ran: the reference must not be on the
+// stereo pair loop and every path with the specialised loops must be (a stereo bus is one link group),
+// otherwise "loops" would be comparing the general loop with itself.
+//
+// --write-golden stores the reference renders: per case a 64-bit hash of the output samples and the RMS
+// of 16 segments of it. --golden checks against such a file: the same hash passes as exact, a different
+// one passes if every segment is within 0.01 dB (another compiler or libm rounding log10 / pow
+// differently), anything else fails.
+// --random N renders N cases of the matrix again with the block size changing on every call (0 up to
+// twice the prepared size, so the processor's chunking runs too), on the reference and the plugin's
+// paths; each has to match its fixed-block render bit for bit.
+// First of all, the gain curve approximations are measured against the exact curve over their whole
+// parameter grid (GainComputer / GainCurveTable::measureMaxErrorDb) and have to stay within the bounds
+// their headers document (maxErrorDb) - every GainComputer kernel the CPU can run, scalar included, not
+// only the one it dispatches to.
+// Exits with 0 when everything passed.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "StreamBatch.h"
+
+#include <cstring>
+#include <iostream>
+#include <map>
+
+namespace
+{
+    using Processor = StereoCompressorBuild1AudioProcessor;
+    using DspPaths = Processor::DspPaths;
+
+    constexpr double signalSeconds = 2.0;
+    constexpr int numSegments = 16;
+    constexpr float goldenToleranceDb = 0.01f;
+
+    //==============================================================================
+    // Stereo, deterministic: a kick / snare pattern getting quieter beat by beat (so every threshold sees
+    // the knee), a different snare noise per side (so unlinked channels differ), over pink noise about
+    // 60 dB down so no chunk is ever silent - where the idle path kicks in depends on the block sizes.
+    juce::AudioBuffer<float> makeSignal (double sampleRate)
+    {
+        const int numSamples = (int) (signalSeconds * sampleRate);
+        juce::AudioBuffer<float> buf (2, numSamples);
+        const float beatLevels[] = { 0.9f, 0.5f, 0.25f, 0.1f };
+        const int beat = (int) (sampleRate * 0.5);
+
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            juce::Random rng (1234 + ch);
+            float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+            auto* d = buf.getWritePointer (ch);
+
+            for (int n = 0; n < numSamples; ++n)
+            {
+                const int pos = n % beat;
+                const bool snare = ((n / beat) % 2) == 1;
+                const float t = (float) (pos / sampleRate);
+                const float env = std::exp (-t * (snare ? 25.0f : 12.0f));
+                const float body = snare ? (rng.nextFloat() * 2.0f - 1.0f)
+                                         : (float) std::sin (juce::MathConstants<double>::twoPi * 55.0 * t);
+
+                const float white = rng.nextFloat() * 2.0f - 1.0f; // Paul Kellet's economy pink filter
+                b0 = 0.99765f * b0 + white * 0.0990460f;
+                b1 = 0.96300f * b1 + white * 0.2965164f;
+                b2 = 0.57000f * b2 + white * 1.0526913f;
+
+                d[n] = beatLevels[(n / beat) % 4] * env * body + 0.001f * (b0 + b1 + b2 + white * 0.1848f);
+            }
+        }
+
+        return buf;
+    }
+
+    //==============================================================================
+    struct Case
+    {
+        int ratioIndex;
+        int detectorMode; // 0 = Peak, 1 = RMS
+        bool hpf;
+        float unlinkPct;
+        float thresholdDb, kneeDb, attackMs, releaseMs;
+        double sampleRate;
+        int blockSize;
+
+        juce::String getKey() const
+        {
+            const char* ratios[] = { "1.5", "3", "4", "6", "10", "20" };
+            return juce::String ("ratio=") + ratios[ratioIndex]
+                 + (detectorMode == 0 ? " det=peak" : " det=rms")
+                 + (hpf ? " hpf=on" : " hpf=off")
+                 + " unlink=" + juce::String ((int) unlinkPct)
+                 + " thr=" + juce::String ((int) thresholdDb)
+                 + " knee=" + juce::String ((int) kneeDb)
+                 + " att=" + juce::String (attackMs, 1)
+                 + " rel=" + juce::String ((int) releaseMs)
+                 + " sr=" + juce::String ((int) sampleRate)
+                 + " block=" + juce::String (blockSize);
+        }
+    };
+
+    // 72 combinations of ratio x detector x HPF x unlink; the 27 grid points (threshold x knee x
+    // attack / release) are spread over them by a stride coprime to 27, so each one comes up
+    std::vector<Case> makeMatrix (bool quick)
+    {
+        const float thresholds[] = { -36.0f, -24.0f, -12.0f };
+        const float knees[] = { 0.0f, 6.0f, 12.0f };
+        const float times[][2] = { { 0.5f, 30.0f }, { 10.0f, 100.0f }, { 50.0f, 600.0f } };
+        const float unlinks[] = { 0.0f, 50.0f, 100.0f };
+
+        std::vector<std::pair<double, int>> formats;
+        if (quick)
+            formats = { { 48000.0, 512 } };
+        else
+            for (double sr : { 44100.0, 48000.0, 96000.0 })
+                for (int bs : { 64, 512 })
+                    formats.push_back ({ sr, bs });
+
+        std::vector<Case> cases;
+        int combination = 0;
+
+        for (int ratio = 0; ratio < 6; ++ratio)
+            for (int det = 0; det < 2; ++det)
+                for (int hpf = 0; hpf < 2; ++hpf)
+                    for (float unlink : unlinks)
+                    {
+                        const int g = (combination++ * 7) % 27;
+
+                        for (const auto& f : formats)
+                            cases.push_back ({ ratio, det, hpf != 0, unlink,
+                                               thresholds[g % 3], knees[(g / 3) % 3], times[g / 9][0], times[g / 9][1],
+                                               f.first, f.second });
+                    }
+
+        return cases;
+    }
+
+    //==============================================================================
+    void setParameter (Processor& proc, const juce::String& id, float value)
+    {
+        if (auto* p = proc.apvts.getParameter (id))
+            p->setValueNotifyingHost (p->convertTo0to1 (value));
+    }
+
+    // The case through processBlock from a fresh prepareToPlay. blockSizes: nullptr = c.blockSize every
+    // call, otherwise a random size per call (0 .. 2 x c.blockSize). Double renders come back as float.
+    // pairLoop: set to whether the core ran the stereo pair detector loop.
+    juce::AudioBuffer<float> render (Processor& proc, const Case& c, const DspPaths& paths, bool doublePrecision,
+                                     const juce::AudioBuffer<float>& input, juce::Random* blockSizes = nullptr,
+                                     bool* pairLoop = nullptr)
+    {
+        setParameter (proc, "ratio",        (float) c.ratioIndex);
+        setParameter (proc, "detectorMode", (float) c.detectorMode);
+        setParameter (proc, "scHPfOn",      c.hpf ? 1.0f : 0.0f);
+        setParameter (proc, "unlink",       c.unlinkPct);
+        setParameter (proc, "threshold",    c.thresholdDb);
+        setParameter (proc, "knee",         c.kneeDb);
+        setParameter (proc, "attack",       c.attackMs);
+        setParameter (proc, "release",      c.releaseMs);
+        proc.updateGainCurve(); // so the table path has a current table from the first block
+
+        proc.setRateAndBufferSizeDetails (c.sampleRate, c.blockSize);
+        proc.setProcessingPrecision (doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                     : juce::AudioProcessor::singlePrecision);
+        proc.setDspPaths (paths);
+        proc.prepareToPlay (c.sampleRate, c.blockSize);
+
+        juce::AudioBuffer<float> output;
+        output.makeCopyOf (input);
+        juce::AudioBuffer<double> outputDouble;
+        if (doublePrecision)
+            outputDouble.makeCopyOf (input);
+
+        juce::MidiBuffer midi;
+        const int numSamples = input.getNumSamples();
+
+        for (int start = 0; start < numSamples;)
+        {
+            const int num = juce::jmin (numSamples - start, blockSizes != nullptr ? blockSizes->nextInt (2 * c.blockSize + 1)
+                                                                                  : c.blockSize);
+            if (doublePrecision)
+            {
+                juce::AudioBuffer<double> block (outputDouble.getArrayOfWritePointers(), 2, start, num);
+                proc.processBlock (block, midi);
+            }
+            else
+            {
+                juce::AudioBuffer<float> block (output.getArrayOfWritePointers(), 2, start, num);
+                proc.processBlock (block, midi);
+            }
+            start += num;
+        }
+
+        if (pairLoop != nullptr)
+            *pairLoop = proc.isUsingStereoPairLoop();
+
+        proc.releaseResources();
+        proc.setDspPaths ({});
+
+        if (doublePrecision)
+            output.makeCopyOf (outputDouble);
+        return output;
+    }
+
+    //==============================================================================
+    // FNV-1a over the bit patterns of every sample, channel after channel
+    juce::uint64 hashOf (const juce::AudioBuffer<float>& buf)
+    {
+        juce::uint64 h = 0xcbf29ce484222325ull;
+        for (int ch = 0; ch < buf.getNumChannels(); ++ch)
+        {
+            const auto* d = buf.getReadPointer (ch);
+            for (int n = 0; n < buf.getNumSamples(); ++n)
+            {
+                uint32_t bits;
+                std::memcpy (&bits, d + n, sizeof (bits));
+                for (int byte = 0; byte < 4; ++byte)
+                {
+                    h ^= (bits >> (8 * byte)) & 0xffu;
+                    h *= 0x100000001b3ull;
+                }
+            }
+        }
+        return h;
+    }
+
+    // RMS over both channels of each of numSegments equal parts, in dB
+    std::vector<float> segmentLevelsDb (const juce::AudioBuffer<float>& buf)
+    {
+        std::vector<float> levels;
+        const int length = buf.getNumSamples() / numSegments;
+
+        for (int s = 0; s < numSegments; ++s)
+        {
+            double sum = 0.0;
+            for (int ch = 0; ch < buf.getNumChannels(); ++ch)
+            {
+                const auto* d = buf.getReadPointer (ch, s * length);
+                for (int n = 0; n < length; ++n)
+                    sum += (double) d[n] * d[n];
+            }
+            const double meanSquare = sum / ((double) length * buf.getNumChannels());
+            levels.push_back (meanSquare > 1.0e-20 ? (float) (10.0 * std::log10 (meanSquare)) : -200.0f);
+        }
+        return levels;
+    }
+
+    // Worst difference between the gains the two renders applied, in dB: the input is the same, so the
+    // ratio of the outputs is the ratio of the gains. 0 = identical, 1000 = a sign flip or a zero.
+    double maxGainDifferenceDb (const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& other)
+    {
+        double worst = 0.0;
+        for (int ch = 0; ch < reference.getNumChannels(); ++ch)
+        {
+            const auto* a = reference.getReadPointer (ch);
+            const auto* b = other.getReadPointer (ch);
+
+            for (int n = 0; n < reference.getNumSamples(); ++n)
+            {
+                if (a[n] == b[n])
+                    continue;
+                if (std::abs (a[n]) < 1.0e-7f) // down at float rounding of the input itself
+                    continue;
+
+                const double ratio = (double) b[n] / (double) a[n];
+                worst = juce::jmax (worst, ratio > 0.0 ? std::abs (20.0 * std::log10 (ratio)) : 1000.0);
+            }
+        }
+        return worst;
+    }
+
+    int firstDifference (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        int first = -1;
+        for (int ch = 0; ch < a.getNumChannels(); ++ch)
+            for (int n = 0; n < a.getNumSamples(); ++n)
+                if (std::memcmp (a.getReadPointer (ch) + n, b.getReadPointer (ch) + n, sizeof (float)) != 0)
+                {
+                    first = first < 0 ? n : juce::jmin (first, n);
+                    break;
+                }
+        return first;
+    }
+
+    //==============================================================================
+    struct GoldenEntry
+    {
+        juce::uint64 hash = 0;
+        std::vector<float> levelsDb;
+    };
+
+    // One line per case: key <tab> hash (hex) <tab> segment levels (dB, space separated)
+    bool readGolden (const juce::File& file, std::map<juce::String, GoldenEntry>& golden)
+    {
+        juce::StringArray lines;
+        file.readLines (lines);
+        if (lines.isEmpty())
+            return false;
+
+        for (const auto& line : lines)
+        {
+            if (line.startsWith ("#") || line.trim().isEmpty())
+                continue;
+
+            const auto fields = juce::StringArray::fromTokens (line, "\t", "");
+            if (fields.size() != 3)
+                return false;
+
+            GoldenEntry e;
+            e.hash = (juce::uint64) fields[1].getHexValue64();
+            for (const auto& level : juce::StringArray::fromTokens (fields[2], " ", ""))
+                e.levelsDb.push_back (level.getFloatValue());
+            golden[fields[0]] = std::move (e);
+        }
+        return true;
+    }
+
+    juce::String goldenLine (const Case& c, const juce::AudioBuffer<float>& output)
+    {
+        juce::StringArray levels;
+        for (float db : segmentLevelsDb (output))
+            levels.add (juce::String (db, 4));
+
+        return c.getKey() + "\t" + juce::String::toHexString ((juce::int64) hashOf (output)).paddedLeft ('0', 16)
+             + "\t" + levels.joinIntoString (" ");
+    }
+
+    //==============================================================================
+    // StreamBatch against a two-channel CompressorCore per stream, bit for bit (StreamBatch.h promises the
+    // core's broadband path). A few settings, stream counts that leave the last group part empty, one and
+    // three threads, and calls longer than the batch's maxBlockSize so it splits them. Prints each
+    // mismatch and returns how many there were.
+    int checkStreamBatch (const juce::AudioBuffer<float>& signal, double sampleRate, int& numChecked)
+    {
+        constexpr int numSamples = 12000, callSize = 1000, batchBlockSize = 256;
+
+        std::vector<CompressorCore::Parameters> settings (4);
+        settings[1].detectorMode = 1;
+        settings[1].scHpfOn = true;
+        settings[1].unlinkPct = 50.0f;
+        settings[1].thresholdDb = -30.0f;
+        settings[1].ratio = 6.0f;
+        settings[2].scHpfOn = true;
+        settings[2].scHpfFreq = 120.0f;
+        settings[2].unlinkPct = 100.0f;
+        settings[2].kneeDb = 0.0f;
+        settings[2].ratio = 20.0f;
+        settings[2].attackMs = 1.0f;
+        settings[2].releaseMs = 50.0f;
+        settings[3].detectorMode = 1;
+        settings[3].unlinkPct = 100.0f;
+        settings[3].gainDb = 6.0f;
+        settings[3].makeupDb = 3.0f;
+        settings[3].thresholdDb = -12.0f;
+
+        int failed = 0;
+
+        for (size_t setting = 0; setting < settings.size(); ++setting)
+            for (int numStreams : { 1, 5, 7, 13 })
+                for (int threads : { 1, 3 })
+                {
+                    // stream s: the signal from a different offset
+                    juce::AudioBuffer<float> viaCore (2 * numStreams, numSamples), viaBatch (2 * numStreams, numSamples);
+                    for (int st = 0; st < numStreams; ++st)
+                        for (int ch = 0; ch < 2; ++ch)
+                        {
+                            const int offset = (st * 997) % (signal.getNumSamples() - numSamples);
+                            viaCore.copyFrom (2 * st + ch, 0, signal, ch, offset, numSamples);
+                            viaBatch.copyFrom (2 * st + ch, 0, signal, ch, offset, numSamples);
+                        }
+
+                    CompressorCore core;
+                    core.allocate (2, callSize, 0);
+                    for (int st = 0; st < numStreams; ++st)
+                    {
+                        core.setSampleRate (sampleRate);
+                        core.setParameters (settings[setting]);
+                        for (int start = 0; start < numSamples; start += callSize)
+                        {
+                            float* channels[] = { viaCore.getWritePointer (2 * st, start), viaCore.getWritePointer (2 * st + 1, start) };
+                            core.process (channels, juce::jmin (callSize, numSamples - start));
+                        }
+                    }
+
+                    StreamBatch batch;
+                    batch.allocate (numStreams, batchBlockSize, threads);
+                    batch.setSampleRate (sampleRate);
+                    batch.setParameters (settings[setting]);
+
+                    std::vector<float*> left ((size_t) numStreams), right ((size_t) numStreams);
+                    for (int start = 0; start < numSamples; start += callSize)
+                    {
+                        for (int st = 0; st < numStreams; ++st)
+                        {
+                            left[(size_t) st] = viaBatch.getWritePointer (2 * st, start);
+                            right[(size_t) st] = viaBatch.getWritePointer (2 * st + 1, start);
+                        }
+                        batch.process (left.data(), right.data(), juce::jmin (callSize, numSamples - start));
+                    }
+
+                    ++numChecked;
+                    for (int st = 0; st < numStreams; ++st)
+                    {
+                        const juce::AudioBuffer<float> a (viaCore.getArrayOfWritePointers() + 2 * st, 2, numSamples);
+                        const juce::AudioBuffer<float> b (viaBatch.getArrayOfWritePointers() + 2 * st, 2, numSamples);
+                        const int first = firstDifference (a, b);
+                        if (first >= 0)
+                        {
+                            ++failed;
+                            std::cout << "FAIL streams  setting " << (int) setting << ", " << numStreams << " streams, "
+                                      << threads << " threads: stream " << st << " differs from sample " << first << std::endl;
+                        }
+                    }
+                }
+
+        return failed;
+    }
+
+    //==============================================================================
+    struct FastPath
+    {
+        const char* name;
+        DspPaths paths;
+        bool doublePrecision;
+        double toleranceDb; // 0 = bit for bit
+
+        int failed = 0;
+        double worstDb = 0.0;
+    };
+
+    DspPaths referencePaths() { return { false, false, false, false }; }
+
+    bool expectsPairLoop (const DspPaths& paths) { return paths.specialisedLoops && paths.stereoPairLoop; }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    bool quick = false;
+    juce::File goldenFile, writeGoldenFile;
+    int numRandom = 0;
+    juce::int64 seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String a (argv[i]);
+        if (a == "--quick")                               quick = true;
+        else if (a == "--golden" && i + 1 < argc)         goldenFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else if (a == "--write-golden" && i + 1 < argc)   writeGoldenFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else if (a == "--random" && i + 1 < argc)         numRandom = juce::String (argv[++i]).getIntValue();
+        else if (a == "--seed" && i + 1 < argc)           seed = juce::String (argv[++i]).getLargeIntValue();
+        else
+        {
+            std::cout << "usage: StereoCompressorRegression [--quick] [--golden <file>] [--write-golden <file>] [--random N] [--seed S]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::map<juce::String, GoldenEntry> golden;
+    if (goldenFile != juce::File() && ! readGolden (goldenFile, golden))
+    {
+        std::cout << "can't read " << goldenFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    Processor proc;
+    {
+        juce::AudioProcessor::BusesLayout buses;
+        buses.inputBuses.add (juce::AudioChannelSet::stereo());
+        buses.inputBuses.add (juce::AudioChannelSet::disabled()); // sidechain not connected
+        buses.outputBuses.add (juce::AudioChannelSet::stereo());
+        proc.setBusesLayout (buses);
+    }
+
+    const DspPaths plugin;
+    const DspPaths loops { true, true, false, false };
+    const DspPaths kernel { true, true, true, false };
+
+    FastPath fastPaths[] = {
+        { "loops",   loops,            false, 0.0 },
+        { "kernel",  kernel,           false, 0.001 },
+        { "table",   plugin,           false, 0.02 },
+        { "double",  referencePaths(), true,  0.001 },
+        { "double+", plugin,           true,  0.02 },
+    };
+
+    const auto cases = makeMatrix (quick);
+    std::map<double, juce::AudioBuffer<float>> inputs;
+    for (const auto& c : cases)
+        if (inputs.count (c.sampleRate) == 0)
+            inputs[c.sampleRate] = makeSignal (c.sampleRate);
+
+    std::cout << "gain computer kernel: " << GainComputer::getKernelName() << ", "
+              << cases.size() << " cases" << std::endl;
+
+    bool passed = true;
+
+    // The approximations on their own, over the full grid (the renders only see the matrix's curves)
+    auto checkBound = [&passed] (const juce::String& name, float errorDb, float boundDb)
+    {
+        const bool ok = errorDb <= boundDb;
+        std::cout << (ok ? "ok   " : "FAIL ") << name.paddedRight (' ', 22) << " max error vs reference: " << errorDb
+                  << " dB (limit " << boundDb << " dB)" << std::endl;
+        passed = passed && ok;
+    };
+    for (int kernel = 0; kernel < GainComputer::getNumKernels(); ++kernel) // not just the one this CPU dispatches to
+        checkBound (juce::String ("gain computer, ") + GainComputer::getKernelName (kernel),
+                    GainComputer::measureMaxErrorDb (kernel), GainComputer::maxErrorDb);
+    checkBound ("curve table", GainCurveTable::measureMaxErrorDb(), GainCurveTable::maxErrorDb);
+    std::cout << std::endl;
+
+    juce::StringArray goldenLines { "# StereoCompressorRegression reference renders: case, FNV-1a 64 of the output, RMS dB of 16 segments" };
+    int goldenExact = 0, goldenClose = 0, goldenFailed = 0, goldenMissing = 0;
+    int wrongLoop = 0; // renders that didn't run the detector loop their paths ask for
+
+    for (const auto& c : cases)
+    {
+        const auto& input = inputs[c.sampleRate];
+        bool pairLoop = false;
+        const auto reference = render (proc, c, referencePaths(), false, input, nullptr, &pairLoop);
+        const auto key = c.getKey();
+
+        if (pairLoop)
+        {
+            ++wrongLoop;
+            std::cout << "FAIL loop     " << key << ": the reference ran the stereo pair loop" << std::endl;
+        }
+
+        if (writeGoldenFile != juce::File())
+            goldenLines.add (goldenLine (c, reference));
+
+        if (! golden.empty())
+        {
+            const auto it = golden.find (key);
+            if (it == golden.end())
+            {
+                ++goldenMissing;
+            }
+            else if (it->second.hash == hashOf (reference))
+            {
+                ++goldenExact;
+            }
+            else
+            {
+                const auto levels = segmentLevelsDb (reference);
+                bool close = levels.size() == it->second.levelsDb.size();
+                for (size_t s = 0; s < levels.size() && close; ++s)
+                    close = std::abs (levels[s] - it->second.levelsDb[s]) <= goldenToleranceDb;
+
+                if (close)
+                {
+                    ++goldenClose;
+                }
+                else
+                {
+                    ++goldenFailed;
+                    std::cout << "FAIL golden  " << key << ": segment levels moved by more than " << goldenToleranceDb << " dB" << std::endl;
+                }
+            }
+        }
+
+        for (auto& path : fastPaths)
+        {
+            const auto output = render (proc, c, path.paths, path.doublePrecision, input, nullptr, &pairLoop);
+
+            if (pairLoop != expectsPairLoop (path.paths))
+            {
+                ++wrongLoop;
+                std::cout << "FAIL loop     " << juce::String (path.name).paddedRight (' ', 8) << key << ": "
+                          << (pairLoop ? "ran" : "didn't run") << " the stereo pair loop" << std::endl;
+            }
+
+            const double differenceDb = maxGainDifferenceDb (reference, output);
+            const bool ok = path.toleranceDb > 0.0 ? differenceDb <= path.toleranceDb
+                                                   : firstDifference (reference, output) < 0;
+            path.worstDb = juce::jmax (path.worstDb, differenceDb);
+
+            if (! ok)
+            {
+                ++path.failed;
+                std::cout << "FAIL " << juce::String (path.name).paddedRight (' ', 8) << key << ": "
+                          << (path.toleranceDb > 0.0 ? "gain off by " + juce::String (differenceDb, 5) + " dB"
+                                                     : "first difference at sample " + juce::String (firstDifference (reference, output)))
+                          << std::endl;
+            }
+        }
+    }
+
+    std::cout << std::endl << "path      cases  failed  worst gain difference" << std::endl;
+    for (const auto& path : fastPaths)
+    {
+        std::cout << juce::String (path.name).paddedRight (' ', 8)
+                  << juce::String ((int) cases.size()).paddedLeft (' ', 7)
+                  << juce::String (path.failed).paddedLeft (' ', 8) << "  "
+                  << (path.worstDb == 0.0 ? juce::String ("exact") : juce::String (path.worstDb, 6) + " dB")
+                  << (path.toleranceDb > 0.0 ? " (limit " + juce::String (path.toleranceDb) + " dB)" : juce::String (" (bit for bit)"))
+                  << std::endl;
+        passed = passed && path.failed == 0;
+    }
+
+    std::cout << std::endl << "detector loop: " << wrongLoop << " renders on the wrong one" << std::endl;
+    passed = passed && wrongLoop == 0;
+
+    {
+        int numChecked = 0;
+        const int streamsFailed = checkStreamBatch (makeSignal (48000.0), 48000.0, numChecked);
+        std::cout << std::endl << "StreamBatch vs a core per stream: " << numChecked << " configurations, "
+                  << streamsFailed << " streams differ" << std::endl;
+        passed = passed && streamsFailed == 0;
+    }
+
+    if (! golden.empty())
+    {
+        std::cout << std::endl << "golden: " << goldenExact << " exact, " << goldenClose << " within " << goldenToleranceDb
+                  << " dB, " << goldenFailed << " failed, " << goldenMissing << " not in " << goldenFile.getFileName() << std::endl;
+        passed = passed && goldenFailed == 0 && goldenMissing == 0;
+    }
+
+    // Variable host block sizes: the same case, fixed blocks vs a new size every call
+    if (numRandom > 0)
+    {
+        juce::Random rng (seed);
+        int randomFailed = 0;
+
+        std::cout << std::endl << "random block sizes, seed " << seed << ": " << numRandom << " cases" << std::endl;
+
+        for (int i = 0; i < numRandom; ++i)
+        {
+            const auto& c = cases[(size_t) rng.nextInt ((int) cases.size())];
+            const auto& input = inputs[c.sampleRate];
+
+            for (const auto& paths : { referencePaths(), plugin })
+            {
+                const auto fixed = render (proc, c, paths, false, input);
+                const auto varied = render (proc, c, paths, false, input, &rng);
+                const int first = firstDifference (fixed, varied);
+
+                if (first >= 0)
+                {
+                    ++randomFailed;
+                    std::cout << "FAIL random  " << c.getKey() << (paths.simdGainCurve ? " (plugin paths)" : " (reference)")
+                              << ": first difference at sample " << first << std::endl;
+                }
+            }
+        }
+
+        std::cout << randomFailed << " failed" << std::endl;
+        passed = passed && randomFailed == 0;
+    }
+
+    if (writeGoldenFile != juce::File())
+    {
+        if (! writeGoldenFile.replaceWithText (goldenLines.joinIntoString ("\n") + "\n"))
+        {
+            std::cout << "can't write " << writeGoldenFile.getFullPathName() << std::endl;
+            return 1;
+        }
+        std::cout << "wrote " << writeGoldenFile.getFullPathName() << std::endl;
+    }
+
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}